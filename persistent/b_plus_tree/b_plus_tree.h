@@ -0,0 +1,519 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <cassert>
+#include <type_traits>
+#include "persistent/persistent_structure.h"
+#include "persistent/node_collector.h"
+#include "binary_tree/key_value_entry.h"
+#include "version.h"
+#include "b_plus_tree_node.h"
+
+namespace persistent
+{
+    //ordered map of wide nodes which keep their keys sorted in arrays, for maps
+    //too big for a node per key. a write copies the path from the root down to
+    //the leaf it changes, unless the version made those nodes itself, so
+    //nothing links leaves together: iterators keep their path from the root
+    template <class key_type, class value_type, size_t fanout = default_fanout>
+    class b_plus_tree :
+        public persistent_structure<b_plus_tree<key_type, value_type, fanout>>
+    {
+        static_assert(fanout >= 4, "a node splits into two of at least two slots");
+        //values are copied with the leaves, nothing would carry their own edits into the tree
+        static_assert(!std::is_base_of<version_structure, value_type>::value,
+                      "b_plus_tree values can't be persistent structures");
+
+    public:
+        typedef typename b_plus_tree_node<key_type, value_type, fanout> node_t;
+        typedef typename node_t::node_ptr_t node_ptr_t;
+        //held through an operation, so writers on other branches may run meanwhile
+        //but version labels don't move under its comparisons
+        typedef typename version_tree<node_ptr_t>::read_guard read_guard;
+
+    private:
+        //an inner node on the way down and the slot of the child taken
+        struct step
+        {
+            node_ptr_t node;
+            size_t slot;
+        };
+
+        typedef std::vector<step> path_t;
+
+        std::shared_ptr<version_tree<node_ptr_t>> vtree;
+        //nodes of every version in vtree, shared with trees created from this one
+        std::shared_ptr<node_pool<node_t>> pool;
+        version current_version;
+
+        node_ptr_t root() const
+        {
+            return vtree->get_value(current_version);
+        }
+
+        //the leaf key belongs to, path gets the inner nodes above it
+        node_ptr_t find_leaf(const key_type& key, path_t& path) const
+        {
+            auto node = root();
+            while (node && !node->leaf)
+            {
+                size_t slot = node->child_slot(key);
+                path.push_back(step{ node, slot });
+                node = node->child(slot);
+            }
+            return node;
+        }
+
+        //the node itself when the current version made it, a copy of it otherwise
+        node_ptr_t writable(const node_ptr_t& node)
+        {
+            if (!node->owner.is_empty() && node->owner == current_version)
+            {
+                return node;
+            }
+            return pool->create(*node, current_version);
+        }
+
+        //moves the upper half of a full node to a new one, which is returned
+        node_ptr_t split(const node_ptr_t& node)
+        {
+            auto right = pool->create(current_version, node->leaf);
+            right->take_last(*node, node->count - fanout / 2);
+            return right;
+        }
+
+        //node was written in place of the child at the end of path, and split_off,
+        //if any, goes right after it. parents are written in turn, and split when full
+        void commit(path_t& path, node_ptr_t node, node_ptr_t split_off)
+        {
+            while (!path.empty())
+            {
+                auto parent = path.back().node;
+                size_t slot = path.back().slot;
+                path.pop_back();
+                if (!split_off && parent->children[slot] == node.get_id())
+                {
+                    //written in place, the versions above see it already
+                    return;
+                }
+
+                auto written = writable(parent);
+                written->children[slot] = node.get_id();
+                node_ptr_t parent_split_off;
+                if (split_off)
+                {
+                    auto target = written;
+                    if (written->count == fanout)
+                    {
+                        parent_split_off = split(written);
+                        if (slot >= fanout / 2)
+                        {
+                            target = parent_split_off;
+                            slot -= fanout / 2;
+                        }
+                    }
+                    target->insert_child(slot + 1, split_off->keys[0], split_off.get_id());
+                }
+                node = written;
+                split_off = parent_split_off;
+            }
+
+            if (split_off)
+            {
+                //the root splits, a new one is put above both halves
+                auto new_root = pool->create(current_version, false);
+                new_root->count = 2;
+                new_root->keys[0] = node->keys[0];
+                new_root->children[0] = node.get_id();
+                new_root->keys[1] = split_off->keys[0];
+                new_root->children[1] = split_off.get_id();
+                node = new_root;
+            }
+            if (node != root())
+            {
+                vtree->update(current_version, node);
+            }
+        }
+
+        //the child at slot of parent, which the current version writes, is short of
+        //keys: it merges with a neighbour when both fit in one node, else takes some of its keys
+        void rebalance(const node_ptr_t& parent, size_t slot)
+        {
+            size_t left_slot = slot > 0 ? slot - 1 : slot;
+            auto left = writable(parent->child(left_slot));
+            auto right = writable(parent->child(left_slot + 1));
+            parent->children[left_slot] = left.get_id();
+            parent->children[left_slot + 1] = right.get_id();
+            if (!right->leaf)
+            {
+                //the separator in parent is the smallest key under right's first child
+                right->keys[0] = parent->keys[left_slot + 1];
+            }
+
+            size_t total = left->count + right->count;
+            if (total <= fanout)
+            {
+                left->take_first(*right, right->count);
+                parent->close_slot(left_slot + 1);
+                return;
+            }
+            if (left->count < total / 2)
+            {
+                left->take_first(*right, total / 2 - left->count);
+            }
+            else
+            {
+                right->take_last(*left, left->count - total / 2);
+            }
+            parent->keys[left_slot + 1] = right->keys[0];
+        }
+
+    public:
+        class iterator
+        {
+            b_plus_tree<key_type, value_type, fanout>* tree;
+            //inner nodes from the root, the leaf and the slot in it
+            path_t path;
+            node_ptr_t leaf;
+            size_t slot;
+
+            std::shared_ptr<key_value_entry<key_type, value_type>> kve;
+
+            void load_entry()
+            {
+                if (!leaf)
+                {
+                    kve.reset();
+                }
+                else if (kve && kve.use_count() == 1)
+                {
+                    //scans reuse the entry when no one else holds it
+                    kve->key = leaf->keys[slot];
+                    kve->value = leaf->value(slot);
+                }
+                else
+                {
+                    kve = std::make_shared<key_value_entry<key_type, value_type>>(leaf->keys[slot], leaf->value(slot));
+                }
+            }
+
+        public:
+            friend class b_plus_tree;
+
+            iterator(b_plus_tree<key_type, value_type, fanout>* tree) :
+                tree(tree),
+                slot(0)
+            {
+            }
+
+            iterator(b_plus_tree<key_type, value_type, fanout>* tree, path_t&& path, node_ptr_t leaf, size_t slot) :
+                tree(tree),
+                path(std::move(path)),
+                leaf(leaf),
+                slot(slot)
+            {
+                if (this->leaf && this->slot == this->leaf->count)
+                {
+                    //past the last key of the leaf, the next one is in the next leaf
+                    this->slot--;
+                    ++*this;
+                    return;
+                }
+                load_entry();
+            }
+
+            iterator& operator++()
+            {
+                read_guard guard(*tree->vtree);
+                if (++slot < leaf->count)
+                {
+                    load_entry();
+                    return *this;
+                }
+                //climbs to the first inner node with a child to the right, and takes its leftmost leaf
+                leaf = node_ptr_t();
+                slot = 0;
+                while (!path.empty() && path.back().slot + 1 == path.back().node->count)
+                {
+                    path.pop_back();
+                }
+                if (!path.empty())
+                {
+                    auto node = path.back().node->child(++path.back().slot);
+                    while (!node->leaf)
+                    {
+                        path.push_back(step{ node, 0 });
+                        node = node->child(0);
+                    }
+                    leaf = node;
+                }
+                load_entry();
+                return *this;
+            }
+
+            key_value_entry<key_type, value_type>& operator*()
+            {
+                return *kve;
+            }
+
+            bool operator==(const iterator& it) const
+            {
+                return leaf == it.leaf && slot == it.slot && get_version() == it.get_version();
+            }
+
+            bool operator!=(const iterator& it) const
+            {
+                return !operator==(it);
+            }
+
+            key_value_entry<key_type, value_type>* operator->() const
+            {
+                return kve.get();
+            }
+
+            version get_version() const
+            {
+                return tree->get_version();
+            }
+        };
+
+        b_plus_tree(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<node_ptr_t>(node_ptr_t(), mode)),
+            pool(new node_pool<node_t>()),
+            current_version(vtree->root_version())
+        {
+        }
+
+        b_plus_tree(b_plus_tree& tree, version v) :
+            vtree(tree.vtree),
+            pool(tree.pool),
+            current_version(v)
+        {
+        }
+
+        b_plus_tree<key_type, value_type, fanout> create_with_version(version v) override
+        {
+            return b_plus_tree<key_type, value_type, fanout>(*this, v);
+        }
+
+        void set_version(const version& v)
+        {
+            current_version = v;
+            version_changed();
+        }
+
+        version get_version() const
+        {
+            return current_version;
+        }
+
+        void switch_new_version() override
+        {
+            auto root_node = root();
+            auto new_version = vtree->insert(current_version, root_node);
+            current_version = new_version;
+        }
+
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            return collect_nodes(*vtree, *pool);
+        }
+
+        iterator find(const key_type& key)
+        {
+            read_guard guard(*vtree);
+            path_t path;
+            auto leaf = find_leaf(key, path);
+            if (!leaf)
+            {
+                return end();
+            }
+            size_t slot = leaf->lower_slot(key);
+            if (slot == leaf->count || key < leaf->keys[slot])
+            {
+                return end();
+            }
+            return iterator(this, std::move(path), leaf, slot);
+        }
+
+        iterator insert(const key_type& key, const value_type& value)
+        {
+            version_changed_notifier vcn(*this);
+            read_guard guard(*vtree);
+            path_t path;
+            auto leaf = find_leaf(key, path);
+            if (!leaf)
+            {
+                prepare_write();
+                leaf = pool->create(current_version, true);
+                leaf->insert_value(0, key, value);
+                vtree->update(current_version, leaf);
+                vtree->update_size(current_version, 1);
+                return iterator(this, path_t(), leaf, 0);
+            }
+
+            size_t slot = leaf->lower_slot(key);
+            bool found = slot < leaf->count && !(key < leaf->keys[slot]);
+            if (found && leaf->value(slot) == value)
+            {
+                return iterator(this, std::move(path), leaf, slot);
+            }
+
+            prepare_write();
+            auto written = writable(leaf);
+            node_ptr_t split_off;
+            if (!found && written->count == fanout)
+            {
+                split_off = split(written);
+                if (slot > fanout / 2)
+                {
+                    //the key goes to the upper half, written stays the lower one
+                    slot -= fanout / 2;
+                    split_off->insert_value(slot, key, value);
+                }
+                else
+                {
+                    written->insert_value(slot, key, value);
+                }
+            }
+            else if (!found)
+            {
+                written->insert_value(slot, key, value);
+            }
+            if (!found)
+            {
+                vtree->update_size(current_version, vtree->get_size(current_version) + 1);
+            }
+            else
+            {
+                written->value(slot) = value;
+            }
+            commit(path, written, split_off);
+            return find(key);
+        }
+
+        iterator erase(iterator it)
+        {
+            if (it == end())
+            {
+                return it;
+            }
+
+            version_changed_notifier vcn(*this);
+            read_guard guard(*vtree);
+            auto key = it->key;
+            path_t path;
+            auto leaf = find_leaf(key, path);
+            size_t slot = leaf->lower_slot(key);
+            assert(slot < leaf->count && !(key < leaf->keys[slot]));
+
+            prepare_write();
+            auto node = writable(leaf);
+            node->close_slot(slot);
+            vtree->update_size(current_version, vtree->get_size(current_version) - 1);
+            bool changed = node != leaf;
+            while (!path.empty())
+            {
+                auto parent = path.back().node;
+                size_t child_slot = path.back().slot;
+                path.pop_back();
+                bool underflow = node->count < node_t::min_count;
+                if (!changed && !underflow)
+                {
+                    break;
+                }
+
+                auto written = writable(parent);
+                written->children[child_slot] = node.get_id();
+                if (underflow && written->count > 1)
+                {
+                    rebalance(written, child_slot);
+                }
+                changed = written != parent;
+                node = written;
+            }
+            if (changed)
+            {
+                vtree->update(current_version, node);
+            }
+
+            //a root left with one child gives way to it, an empty leaf to no root
+            auto root_node = root();
+            if (!root_node->leaf && root_node->count == 1)
+            {
+                vtree->update(current_version, root_node->child(0));
+            }
+            else if (root_node->leaf && root_node->count == 0)
+            {
+                vtree->update(current_version, node_ptr_t());
+            }
+
+            //the successor is looked up again, the writes may have copied it
+            return first_not_less(key);
+        }
+
+        iterator begin()
+        {
+            read_guard guard(*vtree);
+            auto node = root();
+            if (!node)
+            {
+                return end();
+            }
+            path_t path;
+            while (!node->leaf)
+            {
+                path.push_back(step{ node, 0 });
+                node = node->child(0);
+            }
+            return iterator(this, std::move(path), node, 0);
+        }
+
+        iterator end()
+        {
+            return iterator(this);
+        }
+
+        //kept next to the root, O(1)
+        size_t size()
+        {
+            return vtree->get_size(current_version);
+        }
+
+        //levels from the root down to the leaves, which are all equally deep
+        size_t height()
+        {
+            read_guard guard(*vtree);
+            size_t result = 0;
+            for (auto node = root(); node; node = node->leaf ? node_ptr_t() : node->child(0))
+            {
+                result++;
+            }
+            return result;
+        }
+
+        bool operator==(const b_plus_tree& tree) const
+        {
+            return vtree == tree.vtree && current_version == tree.current_version;
+        }
+
+    private:
+        //the first key which isn't less than key
+        iterator first_not_less(const key_type& key)
+        {
+            path_t path;
+            auto leaf = find_leaf(key, path);
+            if (!leaf)
+            {
+                return end();
+            }
+            return iterator(this, std::move(path), leaf, leaf->lower_slot(key));
+        }
+    };
+}
@@ -0,0 +1,275 @@
+#pragma once
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <iterator>
+#include <type_traits>
+#include "version/version_tree.h"
+#include "persistent/node_pool.h"
+
+namespace persistent
+{
+    static const size_t default_fanout = 32;
+
+    //node of a b_plus_tree: up to fanout sorted keys with their values in a leaf,
+    //or with their children in an inner node. a node is never changed once its
+    //version is done, the next versions write copies of it and of its parents.
+    //the version which made it writes it in place, no other version sees it yet
+    template <class key_type, class value_type, size_t fanout>
+    struct b_plus_tree_node
+    {
+        typedef typename b_plus_tree_node<key_type, value_type, fanout> node_t;
+        typedef typename node_handle<node_t> node_ptr_t;
+        typedef typename version_tree<node_ptr_t> version_tree_t;
+
+        static const size_t min_count = fanout / 2;
+
+        //this node in its pool, children are ids in the same pool
+        const node_ptr_t self;
+        //the version which writes the node in place, empty once it is released
+        version owner;
+        bool leaf;
+        uint32_t count;
+        //in an inner node keys[i] is the smallest key under children[i], keys[0] isn't used
+        std::array<key_type, fanout> keys;
+        //a leaf's values or an inner node's children. values are raw slots, only
+        //[0, count) of a leaf hold values, so inner nodes build and copy none
+        union
+        {
+            typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type value_slots[fanout];
+            node_id children[fanout];
+        };
+
+        //created by node_pool::create, which passes self
+        b_plus_tree_node(const node_ptr_t& self, const version& owner, bool leaf) :
+            self(self),
+            owner(owner),
+            leaf(leaf),
+            count(0)
+        {
+        }
+
+        //a copy of from which owner writes
+        b_plus_tree_node(const node_ptr_t& self, const node_t& from, const version& owner) :
+            self(self),
+            owner(owner),
+            leaf(from.leaf),
+            count(from.count),
+            keys(from.keys)
+        {
+            if (leaf)
+            {
+                std::uninitialized_copy_n(from.values(), count, values());
+            }
+            else
+            {
+                std::copy_n(from.children, count, children);
+            }
+        }
+
+        b_plus_tree_node(const b_plus_tree_node&) = delete;
+        b_plus_tree_node& operator=(const b_plus_tree_node&) = delete;
+
+        ~b_plus_tree_node()
+        {
+            if (leaf)
+            {
+                destroy_values(0, count);
+            }
+        }
+
+        value_type* values()
+        {
+            return reinterpret_cast<value_type*>(value_slots);
+        }
+
+        const value_type* values() const
+        {
+            return reinterpret_cast<const value_type*>(value_slots);
+        }
+
+        value_type& value(size_t slot)
+        {
+            return values()[slot];
+        }
+
+        const value_type& value(size_t slot) const
+        {
+            return values()[slot];
+        }
+
+        //counts instead of branching, so for arithmetic keys the loop is vectorized
+        //and a lookup costs no mispredicted jumps.
+        //index of the first key of a leaf which isn't less than key
+        size_t lower_slot(const key_type& key) const
+        {
+            size_t slot = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                slot += keys[i] < key;
+            }
+            return slot;
+        }
+
+        //index of the child of an inner node whose keys key belongs to
+        size_t child_slot(const key_type& key) const
+        {
+            size_t slot = 0;
+            for (size_t i = 1; i < count; i++)
+            {
+                slot += !(key < keys[i]);
+            }
+            return slot;
+        }
+
+        node_ptr_t child(size_t slot) const
+        {
+            return self.at(children[slot]);
+        }
+
+        //puts key and val at slot of a leaf, the slots from there on move up one
+        void insert_value(size_t slot, const key_type& key, const value_type& val)
+        {
+            auto v = values();
+            if (slot == count)
+            {
+                new (v + count) value_type(val);
+            }
+            else
+            {
+                new (v + count) value_type(std::move(v[count - 1]));
+                std::move_backward(v + slot, v + count - 1, v + count);
+                v[slot] = val;
+            }
+            std::copy_backward(keys.begin() + slot, keys.begin() + count, keys.begin() + count + 1);
+            keys[slot] = key;
+            count++;
+        }
+
+        //puts key and child at slot of an inner node, the slots from there on move up one
+        void insert_child(size_t slot, const key_type& key, node_id child)
+        {
+            std::copy_backward(children + slot, children + count, children + count + 1);
+            std::copy_backward(keys.begin() + slot, keys.begin() + count, keys.begin() + count + 1);
+            children[slot] = child;
+            keys[slot] = key;
+            count++;
+        }
+
+        void close_slot(size_t slot)
+        {
+            std::copy(keys.begin() + slot + 1, keys.begin() + count, keys.begin() + slot);
+            if (leaf)
+            {
+                std::move(values() + slot + 1, values() + count, values() + slot);
+                destroy_values(count - 1, count);
+            }
+            else
+            {
+                std::copy(children + slot + 1, children + count, children + slot);
+            }
+            count--;
+        }
+
+        //moves the first n slots of from to the end of this node
+        void take_first(node_t& from, size_t n)
+        {
+            std::copy_n(from.keys.begin(), n, keys.begin() + count);
+            std::copy(from.keys.begin() + n, from.keys.begin() + from.count, from.keys.begin());
+            if (leaf)
+            {
+                std::uninitialized_copy_n(std::make_move_iterator(from.values()), n, values() + count);
+                std::move(from.values() + n, from.values() + from.count, from.values());
+                from.destroy_values(from.count - n, from.count);
+            }
+            else
+            {
+                std::copy_n(from.children, n, children + count);
+                std::copy(from.children + n, from.children + from.count, from.children);
+            }
+            count += (uint32_t)n;
+            from.count -= (uint32_t)n;
+        }
+
+        //moves the last n slots of from to the front of this node
+        void take_last(node_t& from, size_t n)
+        {
+            size_t first = from.count - n;
+            std::copy_backward(keys.begin(), keys.begin() + count, keys.begin() + count + n);
+            std::copy_n(from.keys.begin() + first, n, keys.begin());
+            if (leaf)
+            {
+                //slots from count on are raw, the ones below hold values
+                auto v = values();
+                for (size_t i = count; i-- > 0; )
+                {
+                    if (i + n >= count)
+                    {
+                        new (v + i + n) value_type(std::move(v[i]));
+                    }
+                    else
+                    {
+                        v[i + n] = std::move(v[i]);
+                    }
+                }
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (i < count)
+                    {
+                        v[i] = std::move(from.values()[first + i]);
+                    }
+                    else
+                    {
+                        new (v + i) value_type(std::move(from.values()[first + i]));
+                    }
+                }
+                from.destroy_values(first, from.count);
+            }
+            else
+            {
+                std::copy_backward(children, children + count, children + count + n);
+                std::copy_n(from.children + first, n, children);
+            }
+            count += (uint32_t)n;
+            from.count -= (uint32_t)n;
+        }
+
+        void destroy_values(size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                values()[i].~value_type();
+            }
+        }
+
+        //a version the node was written in is released, no version writes it anymore
+        void prune_mods(const version_tree_t& vtree)
+        {
+            if (!owner.is_empty() && vtree.is_released(owner))
+            {
+                owner = version();
+            }
+        }
+
+        size_t memory_usage() const
+        {
+            return sizeof(node_t);
+        }
+
+        //f gets the id of every child
+        template <class F>
+        void for_each_link(F f)
+        {
+            if (leaf)
+            {
+                return;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                f(children[i]);
+            }
+        }
+    };
+}
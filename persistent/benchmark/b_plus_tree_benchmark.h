@@ -0,0 +1,94 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "b_plus_tree/b_plus_tree.h"
+
+namespace benchmark
+{
+    //big maps: the keys are loaded in batches whose versions are dropped as the
+    //load goes, then found at random, scanned in order and written one version per key
+    template <class tree_t>
+    void b_plus_tree_run(std::ostream& out, const std::string& name, int keys, int lookups, int batch_size)
+    {
+        std::mt19937 gen(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), gen);
+        std::string row = name + ", " + std::to_string(keys) + " keys";
+
+        tree_t tree;
+        auto first = tree.get_version();
+        timer t;
+        for (int i = 0, batches = 1; i < keys; i += batch_size, batches++)
+        {
+            auto before = tree.get_version();
+            {
+                auto batch = tree.batch();
+                for (int j = i; j < std::min(keys, i + batch_size); j++)
+                {
+                    tree.insert(order[j], j);
+                }
+            }
+            //only the loaded map is kept, as after a bulk load
+            if (before != first)
+            {
+                tree.release_version(before);
+            }
+            if (batches % 64 == 0)
+            {
+                tree.collect_garbage();
+            }
+        }
+        print_row(out, row, "us per batched insert", t.elapsed_ms() * 1e3 / keys);
+        print_row(out, row, "bytes per key", (double)tree.collect_garbage() / keys);
+
+        std::uniform_int_distribution<int> key_dist(0, keys - 1);
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < lookups; i++)
+        {
+            found += tree.find(key_dist(gen)) != tree.end();
+        }
+        print_row(out, row, "ns per find", t.elapsed_ms() * 1e6 / lookups);
+
+        t.reset();
+        long long sum = 0;
+        for (auto it = tree.begin(); it != tree.end(); ++it)
+        {
+            sum += it->value;
+        }
+        print_row(out, row, "ns per scanned key", t.elapsed_ms() * 1e6 / keys);
+
+        t.reset();
+        for (int i = 0; i < lookups; i++)
+        {
+            tree.insert(key_dist(gen), -i);
+        }
+        print_row(out, row, "us per versioned insert", t.elapsed_ms() * 1e3 / lookups);
+        print_row(out, row, "bytes per key after", (double)tree.collect_garbage() / keys);
+        //keeps the loops from being optimized out
+        if (found + sum == -1)
+        {
+            out << std::endl;
+        }
+    }
+
+    inline void run_b_plus_tree_benchmark(std::ostream& out = std::cout, std::vector<int> sizes = { 1000000, 10000000 },
+                                          int lookups = 100000, int batch_size = 1000)
+    {
+        print_header(out, "b+ tree");
+        for (int keys : sizes)
+        {
+            b_plus_tree_run<persistent::binary_tree<int, int>>(out, "binary tree", keys, lookups, batch_size);
+            b_plus_tree_run<persistent::b_plus_tree<int, int>>(out, "b+ tree", keys, lookups, batch_size);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <utility>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "binary_tree/red_black_tree.h"
+
+namespace benchmark
+{
+    inline std::vector<int> balanced_tree_keys(const std::string& order, int keys)
+    {
+        std::vector<int> result(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            result[i] = order == "reverse" ? keys - i : i;
+        }
+        if (order == "random")
+        {
+            srand(1);
+            for (int i = 1; i < keys; i++)
+            {
+                std::swap(result[i], result[rand() % (i + 1)]);
+            }
+        }
+        return result;
+    }
+
+    //sorted keys turn the plain tree into a list, every insert and find walks
+    //all of it. the red-black tree pays for colors and rotations instead
+    template <class tree_t>
+    void balanced_tree_run(std::ostream& out, const std::string& name, const std::string& order, int keys, int lookups)
+    {
+        auto key_order = balanced_tree_keys(order, keys);
+        tree_t tree;
+        timer t;
+        for (int key : key_order)
+        {
+            tree.insert(key, key);
+        }
+        std::string row = name + ", " + order;
+        print_row(out, row, "us per insert", t.elapsed_ms() * 1e3 / keys);
+
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < lookups; i++)
+        {
+            found += tree.find(key_order[rand() % keys]) != tree.end();
+        }
+        print_row(out, row, "ns per find", t.elapsed_ms() * 1e6 / lookups);
+        print_row(out, row, "bytes per key", (double)tree.collect_garbage() / keys);
+    }
+
+    inline void run_balanced_tree_benchmark(std::ostream& out = std::cout, int keys = 5000, int lookups = 20000)
+    {
+        print_header(out, "balanced tree");
+        for (auto order : { "sorted", "reverse", "random" })
+        {
+            balanced_tree_run<persistent::binary_tree<int, int>>(out, "plain tree", order, keys, lookups);
+            balanced_tree_run<persistent::red_black_tree<int, int>>(out, "red-black tree", order, keys, lookups);
+        }
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace benchmark
+{
+    class timer
+    {
+        typedef std::chrono::high_resolution_clock clock_t;
+        clock_t::time_point start;
+
+    public:
+        timer() :
+            start(clock_t::now())
+        {
+        }
+
+        void reset()
+        {
+            start = clock_t::now();
+        }
+
+        double elapsed_ms() const
+        {
+            return std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+        }
+    };
+
+    //keeps the slowest single operation of a run to spot pauses
+    class latency_tracker
+    {
+        timer t;
+        double max_ms;
+
+    public:
+        latency_tracker() :
+            max_ms(0)
+        {
+        }
+
+        void begin()
+        {
+            t.reset();
+        }
+
+        void end()
+        {
+            max_ms = std::max(max_ms, t.elapsed_ms());
+        }
+
+        double get_max_ms() const
+        {
+            return max_ms;
+        }
+    };
+
+    inline void print_header(std::ostream& out, const std::string& title)
+    {
+        out << std::endl << "== " << title << " ==" << std::endl;
+    }
+
+    inline void print_row(std::ostream& out, const std::string& name, const std::string& metric, double value)
+    {
+        out << "  " << std::left << std::setw(32) << name
+            << std::setw(24) << metric
+            << std::right << std::fixed << std::setprecision(3) << value << std::endl;
+    }
+}
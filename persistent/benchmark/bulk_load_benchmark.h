@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <random>
+#include <utility>
+#include <algorithm>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    //a tree of keys made by an insert per key, one version each, against one
+    //balanced build of them. sorted keys would make the inserts quadratic, so
+    //they go in shuffled
+    inline void run_bulk_load_benchmark(std::ostream& out = std::cout, int keys = 200000)
+    {
+        typedef persistent::binary_tree<int, int> tree_t;
+        print_header(out, "bulk load");
+        std::vector<std::pair<int, int>> sorted;
+        for (int i = 0; i < keys; i++)
+        {
+            sorted.push_back(std::make_pair(i, i));
+        }
+        auto shuffled = sorted;
+        std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937(1));
+
+        {
+            tree_t tree;
+            timer t;
+            for (auto& e : shuffled)
+            {
+                tree.insert(e.first, e.second);
+            }
+            print_row(out, "insert per key", "ns per key", t.elapsed_ms() * 1e6 / keys);
+            print_row(out, "insert per key", "height", (double)tree.height());
+            print_row(out, "insert per key", "bytes per key", (double)tree.collect_garbage() / keys);
+        }
+        for (auto input : { &sorted, &shuffled })
+        {
+            auto row = input == &sorted ? "from_sorted, sorted" : "from_sorted, shuffled";
+            timer t;
+            auto tree = tree_t::from_sorted(input->begin(), input->end());
+            print_row(out, row, "ns per key", t.elapsed_ms() * 1e6 / keys);
+            print_row(out, row, "height", (double)tree.height());
+            print_row(out, row, "bytes per key", (double)tree.collect_garbage() / keys);
+        }
+    }
+}
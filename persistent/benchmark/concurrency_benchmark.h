@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    //every thread writes to its own branch of one shared tree
+    inline double concurrent_branches_run(int threads, int base_keys, int keys_per_thread)
+    {
+        typedef persistent::binary_tree<int, int> tree_t;
+        tree_t base;
+        srand(1);
+        for (int i = 0; i < base_keys; i++)
+        {
+            base.insert(rand(), i);
+        }
+
+        std::vector<tree_t> branches;
+        for (int i = 0; i < threads; i++)
+        {
+            branches.push_back(base.create_with_version(base.get_version()));
+        }
+
+        timer t;
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++)
+        {
+            workers.push_back(std::thread([&, i]()
+            {
+                auto& branch = branches[i];
+                unsigned seed = i + 1;
+                for (int k = 0; k < keys_per_thread; k++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    branch.insert((int)(seed >> 1), k);
+                }
+            }));
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+        return t.elapsed_ms();
+    }
+
+    inline void run_concurrency_benchmark(std::ostream& out = std::cout, int base_keys = 20000, int keys_per_thread = 20000)
+    {
+        print_header(out, "concurrent writers on independent branches");
+        int max_threads = std::max(1, (int)std::thread::hardware_concurrency());
+        print_row(out, "hardware threads", "count", max_threads);
+        double single_ms = 0;
+        for (int threads = 1; threads <= max_threads * 2; threads *= 2)
+        {
+            double ms = concurrent_branches_run(threads, base_keys, keys_per_thread);
+            if (threads == 1)
+            {
+                single_ms = ms;
+            }
+            std::string name = std::to_string(threads) + " threads";
+            print_row(out, name, "inserts per ms", threads * keys_per_thread / ms);
+            print_row(out, name, "speedup", single_ms * threads / ms);
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "linked_list/linked_list.h"
+
+namespace benchmark
+{
+    //a few keys rewritten over a long history: node-copying keeps every node
+    //small and copies it often, fat nodes never copy but search longer arrays
+    template <bool fat_node>
+    void fat_node_tree_run(std::ostream& out, int keys, int writes, int lookups)
+    {
+        std::string name = fat_node ? "fat tree" : "node-copying tree";
+        persistent::binary_tree<int, int, fat_node> bst;
+        srand(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+            bst.insert(order[i], 0);
+        }
+
+        std::vector<persistent::version> versions;
+        timer t;
+        for (int i = 1; i <= writes; i++)
+        {
+            bst.insert(order[rand() % keys], i);
+            versions.push_back(bst.get_version());
+        }
+        print_row(out, name, "us per write", t.elapsed_ms() * 1e3 / writes);
+
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < lookups; i += 100)
+        {
+            bst.set_version(versions[rand() % writes]);
+            for (int k = 0; k < 100; k++)
+            {
+                found += bst.find(order[rand() % keys])->value;
+            }
+        }
+        print_row(out, name, "ns per old lookup", t.elapsed_ms() * 1e6 / lookups);
+        print_row(out, name, "bytes per write", (double)bst.collect_garbage() / writes);
+    }
+
+    template <bool fat_node>
+    void fat_node_list_run(std::ostream& out, int size, int writes, int lookups)
+    {
+        std::string name = fat_node ? "fat list" : "node-copying list";
+        persistent::linked_list<int, fat_node> l;
+        for (int i = 0; i < size; i++)
+        {
+            l.push_front(i);
+        }
+
+        std::vector<persistent::version> versions;
+        timer t;
+        for (int i = 0; i < writes; i++)
+        {
+            l.pop_front();
+            l.push_front(i);
+            versions.push_back(l.get_version());
+        }
+        print_row(out, name, "us per write", t.elapsed_ms() * 1e3 / (2 * writes));
+
+        t.reset();
+        long long sum = 0;
+        int steps = 0;
+        while (steps < lookups)
+        {
+            l.set_version(versions[rand() % writes]);
+            for (auto it = l.begin(); it != l.end(); ++it, ++steps)
+            {
+                sum += *it;
+            }
+        }
+        print_row(out, name, "ns per old step", t.elapsed_ms() * 1e6 / steps);
+        print_row(out, name, "bytes per write", (double)l.collect_garbage() / writes);
+    }
+
+    inline void run_fat_node_benchmark(std::ostream& out = std::cout, int writes = 100000, int lookups = 200000)
+    {
+        print_header(out, "fat nodes with deep history");
+        fat_node_tree_run<false>(out, 64, writes, lookups);
+        fat_node_tree_run<true>(out, 64, writes, lookups);
+        fat_node_list_run<false>(out, 64, writes, lookups);
+        fat_node_list_run<true>(out, 64, writes, lookups);
+    }
+}
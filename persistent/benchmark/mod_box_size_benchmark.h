@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    //small boxes split often, big ones are slower to scan and copy
+    template <size_t mod_box_size>
+    void mod_box_size_run(std::ostream& out, int keys, int lookups)
+    {
+        typedef persistent::binary_tree<int, int, false, mod_box_size> tree_t;
+        std::string name = std::to_string(mod_box_size) + " slots";
+        srand(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+        }
+
+        tree_t bst;
+        std::vector<persistent::version> versions;
+        timer t;
+        for (int i = 0; i < keys; i++)
+        {
+            bst.insert(order[i], i);
+            versions.push_back(bst.get_version());
+        }
+        print_row(out, name, "us per insert", t.elapsed_ms() * 1e3 / keys);
+
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < lookups; i += 100)
+        {
+            bst.set_version(versions[rand() % keys]);
+            for (int k = 0; k < 100; k++)
+            {
+                found += bst.find(order[rand() % keys]) != bst.end();
+            }
+        }
+        print_row(out, name, "ns per lookup", t.elapsed_ms() * 1e6 / lookups);
+
+        double bytes = (double)bst.collect_garbage();
+        print_row(out, name, "bytes per key", bytes / keys);
+        print_row(out, name, "nodes per key", bytes / sizeof(typename tree_t::node_t) / keys);
+    }
+
+    inline void run_mod_box_size_benchmark(std::ostream& out = std::cout, int keys = 20000, int lookups = 200000)
+    {
+        print_header(out, "mod box size sweep");
+        mod_box_size_run<2>(out, keys, lookups);
+        mod_box_size_run<4>(out, keys, lookups);
+        mod_box_size_run<8>(out, keys, lookups);
+        mod_box_size_run<16>(out, keys, lookups);
+        mod_box_size_run<32>(out, keys, lookups);
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <cstdlib>
+#include "benchmark.h"
+#include "version/version_tree.h"
+#include "persistent/mod_index.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    struct lookup_entry
+    {
+        size_t field;
+        persistent::version v;
+    };
+
+    //the latest entry of field seen by v found by scanning the whole box
+    inline int scan_box(const std::vector<lookup_entry>& box, size_t field, const persistent::version& v)
+    {
+        persistent::version v_last;
+        int found = -1;
+        for (size_t i = 0; i < box.size(); i++)
+        {
+            if (box[i].field == field && box[i].v <= v && v_last < box[i].v)
+            {
+                v_last = box[i].v;
+                found = (int)i;
+            }
+        }
+        return found;
+    }
+
+    //one full box of a node with four fields written in versions of a random version tree
+    inline void mod_lookup_run(std::ostream& out, int versions, int lookups)
+    {
+        const size_t fields = 4;
+        const size_t box_size = 2 * fields;
+        persistent::version_tree<int> vtree;
+        std::vector<persistent::version> all = { vtree.root_version() };
+        for (int i = 1; i < versions; i++)
+        {
+            all.push_back(vtree.insert(all[rand() % all.size()], i));
+        }
+
+        std::vector<lookup_entry> box;
+        persistent::mod_index<fields> index;
+        for (size_t slot = 0; slot < box_size; slot++)
+        {
+            lookup_entry mod_entry = { slot % fields, all[rand() % all.size()] };
+            box.push_back(mod_entry);
+            index.insert(mod_entry.field, mod_entry.v, slot);
+        }
+
+        std::vector<persistent::version> queries;
+        for (int i = 0; i < lookups; i++)
+        {
+            queries.push_back(all[rand() % all.size()]);
+        }
+
+        long long check = 0;
+        timer t;
+        for (int i = 0; i < lookups; i++)
+        {
+            check += scan_box(box, i % fields, queries[i]);
+        }
+        print_row(out, "scan", "ns per field read", t.elapsed_ms() * 1e6 / lookups);
+
+        t.reset();
+        for (int i = 0; i < lookups; i++)
+        {
+            check -= index.find(i % fields, queries[i]);
+        }
+        print_row(out, "per field index", "ns per field read", t.elapsed_ms() * 1e6 / lookups);
+        print_row(out, "results differ", "count", (double)check);
+    }
+
+    //finds in old versions of a tree built one insert per version
+    inline void tree_lookup_run(std::ostream& out, int keys, int lookups)
+    {
+        persistent::binary_tree<int, int> bst;
+        std::vector<int> order(keys);
+        std::vector<persistent::version> versions;
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+            bst.insert(order[i], i);
+            versions.push_back(bst.get_version());
+        }
+
+        long long found = 0;
+        timer t;
+        for (int i = 0; i < lookups; i += 100)
+        {
+            bst.set_version(versions[rand() % keys]);
+            for (int k = 0; k < 100; k++)
+            {
+                found += bst.find(order[rand() % keys]) != bst.end();
+            }
+        }
+        print_row(out, "binary_tree find", "ns per lookup", t.elapsed_ms() * 1e6 / lookups);
+        print_row(out, "binary_tree find", "keys found", (double)found);
+    }
+
+    inline void run_mod_lookup_benchmark(std::ostream& out = std::cout, int versions = 100000, int lookups = 1000000)
+    {
+        print_header(out, "mod box field resolution");
+        srand(1);
+        mod_lookup_run(out, versions, lookups);
+        tree_lookup_run(out, 20000, lookups);
+    }
+}
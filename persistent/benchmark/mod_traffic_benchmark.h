@@ -0,0 +1,56 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    //mod entries and node copies one write of the tree leaves behind. entries
+    //are counted before garbage is collected, splits are the nodes which
+    //aren't a key of their own
+    inline void mod_traffic_tree_run(std::ostream& out, int keys, int churn)
+    {
+        persistent::binary_tree<int, int> bst;
+        srand(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = i;
+            std::swap(order[i], order[rand() % (i + 1)]);
+        }
+
+        timer t;
+        for (int i = 0; i < keys; i++)
+        {
+            bst.insert(order[i], i);
+        }
+        double ms = t.elapsed_ms();
+        auto stats = bst.get_node_stats();
+        print_row(out, "tree inserts", "us per insert", ms * 1e3 / keys);
+        print_row(out, "tree inserts", "mod entries per insert", (double)stats.mod_entries / keys);
+        print_row(out, "tree inserts", "splits per insert", (double)(stats.nodes - keys) / keys);
+
+        //erase and insert again keep the key count
+        auto before = stats;
+        t.reset();
+        for (int i = 0; i < churn; i++)
+        {
+            int key = order[rand() % keys];
+            bst.erase(bst.find(key));
+            bst.insert(key, i);
+        }
+        ms = t.elapsed_ms();
+        stats = bst.get_node_stats();
+        print_row(out, "tree erase and insert", "us per pair", ms * 1e3 / churn);
+        print_row(out, "tree erase and insert", "mod entries per pair", (double)(stats.mod_entries - before.mod_entries) / churn);
+        print_row(out, "tree erase and insert", "splits per pair", (double)(stats.nodes - before.nodes - churn) / churn);
+    }
+
+    inline void run_mod_traffic_benchmark(std::ostream& out = std::cout, int keys = 20000, int churn = 20000)
+    {
+        print_header(out, "mod traffic per write");
+        mod_traffic_tree_run(out, keys, churn);
+    }
+}
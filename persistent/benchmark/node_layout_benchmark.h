@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "linked_list/linked_list.h"
+
+namespace benchmark
+{
+    //the hot paths which walk links: every step reads a link from a node or
+    //its mod box and dereferences it
+    inline void node_layout_tree_run(std::ostream& out, int keys, int lookups)
+    {
+        persistent::binary_tree<int, int> bst;
+        srand(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+        }
+
+        timer t;
+        for (int i = 0; i < keys; i++)
+        {
+            bst.insert(order[i], i);
+        }
+        print_row(out, "tree", "us per insert", t.elapsed_ms() * 1e3 / keys);
+
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < lookups; i++)
+        {
+            found += bst.find(order[rand() % keys]) != bst.end();
+        }
+        print_row(out, "tree", "ns per find", t.elapsed_ms() * 1e6 / lookups);
+
+        t.reset();
+        long long sum = 0;
+        for (auto it = bst.begin(); it != bst.end(); ++it)
+        {
+            sum += it->value;
+        }
+        print_row(out, "tree", "ns per iterated key", t.elapsed_ms() * 1e6 / keys);
+        print_row(out, "tree", "bytes per key", (double)bst.collect_garbage() / keys);
+    }
+
+    inline void node_layout_list_run(std::ostream& out, int size)
+    {
+        persistent::linked_list<int> l;
+        timer t;
+        for (int i = 0; i < size; i++)
+        {
+            l.push_front(i);
+        }
+        print_row(out, "list", "us per push", t.elapsed_ms() * 1e3 / size);
+
+        t.reset();
+        long long sum = 0;
+        for (auto it = l.begin(); it != l.end(); ++it)
+        {
+            sum += *it;
+        }
+        print_row(out, "list", "ns per iterated value", t.elapsed_ms() * 1e6 / size);
+    }
+
+    inline void run_node_layout_benchmark(std::ostream& out = std::cout, int keys = 100000, int lookups = 500000)
+    {
+        print_header(out, "node layout");
+        node_layout_tree_run(out, keys, lookups);
+        node_layout_list_run(out, keys);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "linked_list/linked_list.h"
+
+namespace benchmark
+{
+    template <class value_type>
+    value_type make_value(int i);
+
+    template <>
+    inline int make_value<int>(int i)
+    {
+        return i;
+    }
+
+    template <>
+    inline std::string make_value<std::string>(int i)
+    {
+        return "value " + std::to_string(i);
+    }
+
+    //bytes per key are the ones collect_garbage() reports over every version
+    template <class value_type>
+    void node_size_run(std::ostream& out, const std::string& name, int keys)
+    {
+        typedef persistent::binary_tree<int, value_type> tree_t;
+        typedef persistent::linked_list<value_type> list_t;
+        print_row(out, name, "tree entry bytes", (double)sizeof(typename tree_t::node_t::mod_box_entry));
+        print_row(out, name, "tree node bytes", (double)sizeof(typename tree_t::node_t));
+        print_row(out, name, "list entry bytes", (double)sizeof(typename list_t::node_t::mod_box_entry));
+        print_row(out, name, "list node bytes", (double)sizeof(typename list_t::node_t));
+
+        tree_t bst;
+        srand(1);
+        for (int i = 0; i < keys; i++)
+        {
+            bst.insert(rand(), make_value<value_type>(i));
+        }
+        print_row(out, name, "tree bytes per key", (double)bst.collect_garbage() / keys);
+
+        list_t l;
+        for (int i = 0; i < keys; i++)
+        {
+            l.push_front(make_value<value_type>(i));
+        }
+        print_row(out, name, "list bytes per key", (double)l.collect_garbage() / keys);
+    }
+
+    inline void run_node_size_benchmark(std::ostream& out = std::cout, int keys = 20000)
+    {
+        print_header(out, "node size");
+        node_size_run<int>(out, "int values", keys);
+        node_size_run<std::string>(out, "string values", keys);
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include <cstdlib>
+#include "benchmark.h"
+#include "version/version_tree.h"
+#include "binary_tree/binary_tree.h"
+
+namespace benchmark
+{
+    inline const char* mode_name(persistent::persistence_mode mode)
+    {
+        return mode == persistent::persistence_mode::full ? "full" : "partial";
+    }
+
+    inline void persistence_mode_run(std::ostream& out, persistent::persistence_mode mode, int versions, int keys)
+    {
+        std::string name = mode_name(mode);
+        {
+            persistent::version_tree<int> vtree(0, mode);
+            auto v = vtree.root_version();
+            timer t;
+            for (int i = 1; i <= versions; i++)
+            {
+                v = vtree.insert(v, i);
+            }
+            print_row(out, name, "ns per linear version", t.elapsed_ms() * 1e6 / versions);
+        }
+
+        persistent::binary_tree<int, int> bst(mode);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+        }
+        timer t;
+        persistent::version middle;
+        for (int i = 0; i < keys; i++)
+        {
+            bst.insert(order[i], i);
+            if (i == keys / 2)
+            {
+                middle = bst.get_version();
+            }
+        }
+        print_row(out, name, "us per tree insert", t.elapsed_ms() * 1e3 / keys);
+
+        t.reset();
+        long long found = 0;
+        for (int i = 0; i < keys; i++)
+        {
+            found += bst.find(order[i]) != bst.end();
+        }
+        bst.set_version(middle);
+        for (int i = 0; i < keys; i++)
+        {
+            found += bst.find(order[i]) != bst.end();
+        }
+        print_row(out, name, "us per tree lookup", t.elapsed_ms() * 1e3 / (2 * keys));
+        print_row(out, name, "keys found", (double)found);
+    }
+
+    //the same linear workload with order list labels and with timestamps
+    inline void run_persistence_mode_benchmark(std::ostream& out = std::cout, int versions = 1000000, int keys = 20000)
+    {
+        print_header(out, "full vs partial persistence");
+        srand(1);
+        persistence_mode_run(out, persistent::persistence_mode::full, versions, keys);
+        srand(1);
+        persistence_mode_run(out, persistent::persistence_mode::partial, versions, keys);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "linked_list/linked_list.h"
+
+namespace benchmark
+{
+    //updates of a few hot keys fill their boxes within a handful of versions,
+    //so nearly every write copies a node and relinks its neighbours
+    inline void split_tree_run(std::ostream& out, int keys, int writes)
+    {
+        persistent::binary_tree<int, int> bst;
+        srand(1);
+        std::vector<int> order(keys);
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+            bst.insert(order[i], 0);
+        }
+
+        latency_tracker latency;
+        timer t;
+        for (int i = 1; i <= writes; i++)
+        {
+            latency.begin();
+            bst.insert(order[rand() % keys], i);
+            latency.end();
+        }
+        double ms = t.elapsed_ms();
+        print_row(out, "tree value updates", "us per write", ms * 1e3 / writes);
+        print_row(out, "tree value updates", "max write, ms", latency.get_max_ms());
+        print_row(out, "tree value updates", "bytes per write", (double)bst.collect_garbage() / writes);
+
+        t.reset();
+        for (int i = 1; i <= writes; i++)
+        {
+            int key = order[rand() % keys];
+            bst.erase(bst.find(key));
+            bst.insert(key, i);
+        }
+        print_row(out, "tree erase and insert", "us per write", t.elapsed_ms() * 1e3 / (2 * writes));
+    }
+
+    inline void split_list_run(std::ostream& out, int size, int writes)
+    {
+        persistent::linked_list<int> l;
+        for (int i = 0; i < size; i++)
+        {
+            l.push_front(i);
+        }
+
+        timer t;
+        for (int i = 0; i < writes; i++)
+        {
+            l.pop_front();
+            l.push_front(i);
+        }
+        print_row(out, "list pop and push", "us per write", t.elapsed_ms() * 1e3 / (2 * writes));
+    }
+
+    inline void run_split_benchmark(std::ostream& out = std::cout, int writes = 200000)
+    {
+        print_header(out, "split heavy writes");
+        split_tree_run(out, 64, writes);
+        split_list_run(out, 64, writes);
+    }
+}
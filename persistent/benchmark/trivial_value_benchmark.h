@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <cstdlib>
+#include "benchmark.h"
+#include "binary_tree/binary_tree.h"
+#include "linked_list/linked_list.h"
+
+namespace benchmark
+{
+    //int keys and values: entry copies in splits and collections are the
+    //part which depends on how entries of trivial types are stored
+    inline void trivial_value_tree_run(std::ostream& out, int keys, int writes)
+    {
+        persistent::binary_tree<int, int> bst;
+        srand(1);
+        std::vector<int> order(keys);
+        timer t;
+        for (int i = 0; i < keys; i++)
+        {
+            order[i] = rand();
+            bst.insert(order[i], i);
+        }
+        print_row(out, "binary_tree<int, int>", "us per insert", t.elapsed_ms() * 1e3 / keys);
+
+        std::vector<persistent::version> versions;
+        t.reset();
+        for (int i = 0; i < writes; i++)
+        {
+            bst.insert(order[rand() % keys], keys + i);
+            versions.push_back(bst.get_version());
+        }
+        print_row(out, "binary_tree<int, int>", "us per update", t.elapsed_ms() * 1e3 / writes);
+
+        t.reset();
+        long long sum = 0;
+        for (int i = 0; i < writes; i++)
+        {
+            sum += bst.find(order[rand() % keys])->value;
+        }
+        print_row(out, "binary_tree<int, int>", "ns per find", t.elapsed_ms() * 1e6 / writes);
+
+        for (size_t i = 0; i + 1 < versions.size(); i++)
+        {
+            if (i % 16)
+            {
+                bst.release_version(versions[i]);
+            }
+        }
+        t.reset();
+        bst.collect_garbage();
+        print_row(out, "binary_tree<int, int>", "collection, ms", t.elapsed_ms());
+    }
+
+    inline void trivial_value_list_run(std::ostream& out, int size, int writes)
+    {
+        persistent::linked_list<int> l;
+        timer t;
+        for (int i = 0; i < size; i++)
+        {
+            l.push_front(i);
+        }
+        print_row(out, "linked_list<int>", "us per push", t.elapsed_ms() * 1e3 / size);
+
+        std::vector<persistent::version> versions;
+        t.reset();
+        for (int i = 0; i < writes; i++)
+        {
+            l.pop_front();
+            l.push_front(i);
+            versions.push_back(l.get_version());
+        }
+        print_row(out, "linked_list<int>", "us per pop and push", t.elapsed_ms() * 1e3 / writes);
+
+        t.reset();
+        long long sum = 0;
+        for (auto it = l.begin(); it != l.end(); ++it)
+        {
+            sum += *it;
+        }
+        print_row(out, "linked_list<int>", "ns per iterated value", t.elapsed_ms() * 1e6 / size);
+
+        for (size_t i = 0; i + 1 < versions.size(); i++)
+        {
+            if (i % 16)
+            {
+                l.release_version(versions[i]);
+            }
+        }
+        t.reset();
+        l.collect_garbage();
+        print_row(out, "linked_list<int>", "collection, ms", t.elapsed_ms());
+    }
+
+    //entries of trivial types copy as raw bytes, inserts into
+    //arrays of them shift them with memmove
+    inline void trivial_value_entry_run(std::ostream& out, int entries, int inserts)
+    {
+        typedef persistent::binary_tree<int, int>::node_t node_t;
+        typedef node_t::mod_box_entry entry_t;
+        persistent::version_tree<node_t::node_ptr_t> vtree;
+        auto v = vtree.root_version();
+        std::vector<entry_t> box;
+        for (int i = 0; i < entries; i++)
+        {
+            box.push_back(i % 3 ? entry_t::make<node_t::value_field>(v, i) :
+                                  entry_t::make<node_t::left_field>(v, (persistent::node_id)i));
+        }
+
+        timer t;
+        size_t copied = 0;
+        for (int i = 0; i < 20; i++)
+        {
+            std::vector<entry_t> copy(box);
+            copied += copy.size();
+        }
+        print_row(out, "int entries", "ns per entry copy", t.elapsed_ms() * 1e6 / copied);
+
+        t.reset();
+        for (int i = 0; i < inserts; i++)
+        {
+            box.insert(box.begin() + i, box[i]);
+        }
+        print_row(out, "int entries", "us per middle insert", t.elapsed_ms() * 1e3 / inserts);
+    }
+
+    inline void run_trivial_value_benchmark(std::ostream& out = std::cout, int size = 100000, int writes = 200000)
+    {
+        print_header(out, "trivial values");
+        trivial_value_tree_run(out, size, writes);
+        trivial_value_list_run(out, size, writes);
+        trivial_value_entry_run(out, 1000000, 2000);
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <vector>
+#include <list>
+#include <memory>
+#include <cstdlib>
+#include "benchmark.h"
+#include "version/version_tree.h"
+
+namespace benchmark
+{
+    //parent_of picks the version a new one is branched from
+    template <class parent_policy>
+    void version_tree_run(std::ostream& out, const std::string& name, int n, parent_policy parent_of)
+    {
+        persistent::version_tree<int> vtree;
+        std::vector<persistent::version> versions = { vtree.root_version() };
+        versions.reserve(n + 1);
+        latency_tracker latency;
+        timer t;
+        for (int i = 1; i <= n; i++)
+        {
+            auto& parent = versions[parent_of(i)];
+            latency.begin();
+            versions.push_back(vtree.insert(parent, i));
+            latency.end();
+        }
+        double total_ms = t.elapsed_ms();
+
+        auto stats = vtree.get_order_stats();
+        print_row(out, name, "ns per version", total_ms * 1e6 / n);
+        print_row(out, name, "max insert, ms", latency.get_max_ms());
+        print_row(out, name, "relabels per version", (double)stats.relabel_count / n);
+        print_row(out, name, "max relabel size", (double)stats.max_relabel_size);
+    }
+
+    inline void run_version_tree_benchmark(std::ostream& out = std::cout, int n = 1000000)
+    {
+        print_header(out, "version_tree insertion");
+        print_row(out, "labels", "bits", persistent::label_traits<persistent::label_type>::bits);
+        version_tree_run(out, "linear history", n,
+            [](int i)
+            {
+                return i - 1;
+            });
+        version_tree_run(out, "hot spot branching", n,
+            [](int i)
+            {
+                return 0;
+            });
+        version_tree_run(out, "hot spot + chains", n,
+            [](int i)
+            {
+                return (i % 2) ? 0 : i - 1;
+            });
+        version_tree_run(out, "random branching", n,
+            [](int i)
+            {
+                return rand() % i;
+            });
+    }
+
+    //record layout of the list based version tree (one heap node per version
+    //with a self iterator), kept as the baseline for version creation
+    template <class value_type>
+    struct list_version_record
+    {
+        persistent::label_type begin_label;
+        persistent::label_type end_label;
+        value_type value;
+        typename std::list<list_version_record>::iterator list_iterator;
+    };
+
+    inline void run_version_creation_benchmark(std::ostream& out = std::cout, int n = 1000000)
+    {
+        typedef std::shared_ptr<int> value_t;
+        print_header(out, "version creation");
+        value_t value(new int(0));
+
+        {
+            timer t;
+            std::list<list_version_record<value_t>> records;
+            for (int i = 0; i < n; i++)
+            {
+                list_version_record<value_t> record;
+                record.begin_label = i;
+                record.end_label = i;
+                record.value = value;
+                records.push_back(record);
+                records.back().list_iterator = std::prev(records.end());
+            }
+            print_row(out, "std::list records", "ns per version", t.elapsed_ms() * 1e6 / n);
+        }
+
+        {
+            timer t;
+            persistent::slab<persistent::version_internal<value_t>> records;
+            for (int i = 0; i < n; i++)
+            {
+                records.push_back(persistent::version_internal<value_t>(value));
+            }
+            print_row(out, "slab records", "ns per version", t.elapsed_ms() * 1e6 / n);
+        }
+
+        {
+            timer t;
+            persistent::version_tree<value_t> vtree(value);
+            auto v = vtree.root_version();
+            for (int i = 0; i < n; i++)
+            {
+                v = vtree.insert(v, value);
+            }
+            print_row(out, "version_tree, linear", "ns per version", t.elapsed_ms() * 1e6 / n);
+        }
+
+        {
+            timer t;
+            persistent::version_tree<value_t> vtree(value);
+            auto root = vtree.root_version();
+            for (int i = 0; i < n; i++)
+            {
+                vtree.insert(root, value);
+            }
+            print_row(out, "version_tree, branching", "ns per version", t.elapsed_ms() * 1e6 / n);
+        }
+    }
+}
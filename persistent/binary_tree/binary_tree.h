@@ -1,25 +1,39 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <utility>
+#include <algorithm>
 #include <cassert>
 #include "persistent/persistent_structure.h"
+#include "persistent/node_collector.h"
+#include "persistent/parallel_sort.h"
 #include "version.h"
 #include "binary_tree_node.h"
+#include "tree_iterator.h"
+#include "tree_range.h"
 #include "utils.h"
 
 namespace persistent
 {
-    template <class key_type, class value_type>
+    //size() is kept next to the root of every version. a counted tree also keeps
+    //the number of keys under every node, which rank() and select() need and every
+    //insert and erase writes on each node above the key
+    template <class key_type, class value_type, bool fat_node = false, size_t mod_box_size = default_mod_box_size, bool counted = false>
     class binary_tree :
-        public persistent_structure<binary_tree<key_type, value_type>>
+        public persistent_structure<binary_tree<key_type, value_type, fat_node, mod_box_size, counted>>
     {
     public:
-        typedef typename binary_tree_node<key_type, value_type> node_t;
-        typedef typename std::shared_ptr<node_t> node_ptr_t;
+        typedef typename binary_tree_node<key_type, value_type, fat_node, mod_box_size, counted> node_t;
+        typedef typename node_t::node_ptr_t node_ptr_t;
         typedef typename version_context<node_ptr_t> version_context_t;
+        //held through an operation, so writers on other branches may run meanwhile
+        //but version labels don't move under its comparisons
+        typedef typename version_tree<node_ptr_t>::read_guard read_guard;
 
     private:
         std::shared_ptr<version_tree<node_ptr_t>> vtree;
+        //nodes of every version in vtree, shared with trees created from this one
+        std::shared_ptr<node_pool<node_t>> pool;
         version current_version;
 
         node_ptr_t find_parent(const key_type& key, node_ptr_t node, node_ptr_t parent)
@@ -52,93 +66,56 @@ namespace persistent
             return vtree->get_value(current_version);
         }
 
-        version_context_t get_vc()
+        typedef std::integral_constant<bool, counted> counted_t;
+
+        //one key more or less under node, which may copy it
+        node_ptr_t add_count(const node_ptr_t& node, int delta, const version_context_t& vc, std::true_type)
         {
-            return version_context_t(this, get_version(), vtree.get());
+            return node->set_count(node->get_count(vc) + delta, vc);
         }
 
-    public:
-        class iterator
+        node_ptr_t add_count(const node_ptr_t& node, int delta, const version_context_t& vc, std::false_type)
         {
-            binary_tree<key_type, value_type>* bst;
-            node_ptr_t node;
-
-            std::shared_ptr<key_value_entry<key_type, value_type>> kve;
-
-            value_type& get_value_ref() const
-            {
-                return node->get_value(bst->get_vc());
-            }
-
-        public:
-            friend class binary_tree;
-
-            iterator(binary_tree<key_type, value_type>* bst, node_ptr_t node = node_ptr_t()) :
-                bst(bst),
-                node(node)
-            {
-                if (node)
-                {
-                    auto vc = bst->get_vc();
-                    kve = std::shared_ptr<key_value_entry<key_type, value_type>>
-                        (new key_value_entry<key_type, value_type>(node->get_key(vc), node->get_value(vc)));
-                }
-            }
-
-            iterator& operator++()
-            {
-                auto vc = bst->get_vc();
-                node = node->next_node(vc);
-                kve.reset();
-                if (node)
-                {
-                    kve = std::shared_ptr<key_value_entry<key_type, value_type>>
-                        (new key_value_entry<key_type, value_type>(node->get_key(vc), node->get_value(vc)));
-                }
-                return *this;
-            }
-
-            key_value_entry<key_type, value_type>& operator*()
-            {
-                return *kve;
-            }
+            return node;
+        }
 
-            bool operator==(const iterator& it) const
-            {
-                return node == it.node && get_version() == it.get_version();
-            }
+        uint32_t count_of(const node_ptr_t& node, const version_context_t& vc, std::true_type)
+        {
+            return node->get_count(vc);
+        }
 
-            bool operator!=(const iterator& it) const
-            {
-                return !operator==(it);
-            }
+        uint32_t count_of(const node_ptr_t& node, const version_context_t& vc, std::false_type)
+        {
+            return 0;
+        }
 
-            key_value_entry<key_type, value_type>* operator->() const
-            {
-                return kve.get();
-            }
+        version_context_t get_vc()
+        {
+            return version_context_t(this, get_version(), vtree.get());
+        }
 
-            version get_version() const
-            {
-                return bst->get_version();
-            }
-        };
+    public:
+        typedef typename tree_iterator<binary_tree<key_type, value_type, fat_node, mod_box_size, counted>, node_ptr_t, key_type, value_type> iterator;
+        friend iterator;
+        typedef typename tree_range<iterator> range_t;
 
-        binary_tree() :
-            vtree(new version_tree<node_ptr_t>),
+        binary_tree(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<node_ptr_t>(node_ptr_t(), mode)),
+            pool(new node_pool<node_t>()),
             current_version(vtree->root_version())
         {
         }
 
         binary_tree(binary_tree& bst, version v) :
             vtree(bst.vtree),
+            pool(bst.pool),
             current_version(v)
         {
         }
 
-        binary_tree<key_type, value_type> create_with_version(version v) override
+        binary_tree<key_type, value_type, fat_node, mod_box_size, counted> create_with_version(version v) override
         {
-            return binary_tree<key_type, value_type>(*this, v);
+            return binary_tree<key_type, value_type, fat_node, mod_box_size, counted>(*this, v);
         }
 
         void set_version(const version& v)
@@ -159,8 +136,27 @@ namespace persistent
             current_version = new_version;
         }
 
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            return collect_nodes(*vtree, *pool);
+        }
+
+        //nodes and mod entries of every version, before garbage is collected
+        node_stats get_node_stats()
+        {
+            read_guard guard(*vtree);
+            return count_nodes(*pool);
+        }
+
         iterator find(const key_type& key)
         {
+            read_guard guard(*vtree);
             auto root_node = root();
             if (!root_node)
             {
@@ -181,58 +177,58 @@ namespace persistent
         iterator insert(const key_type& key, const value_type& value)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            read_guard guard(*vtree);
             auto root_node = root();
             if (!root_node)
             {
-                root_node = node_ptr_t(new node_t(key, value, get_vc()));
+                prepare_write();
+                root_node = pool->create(key, value, get_vc());
                 vtree->update(get_version(), root_node);
+                vtree->update_size(get_version(), 1);
                 return iterator(this, root_node);
             }
 
             auto parent = find_parent(key, root_node, root_node);
-            if (parent->key == key && parent->value == value)
-            {
-                return iterator(this, parent);
-            }
-
-            node_ptr_t inserted_node;
             if (parent->key == key)
             {
-                parent->set_value(value, get_vc());
-                inserted_node = parent;
-            }
-            else if (key < parent->key)
-            {
-                auto left = parent->get_left(get_vc());
-                if (left)
+                if (parent->get_value(get_vc()) == value)
                 {
-                    left->set_value(value, get_vc());
-                    inserted_node = left;
+                    return iterator(this, parent);
                 }
-                else
+                prepare_write();
+                return iterator(this, parent->set_value(value, get_vc()));
+            }
+
+            prepare_write();
+            auto vc = get_vc();
+            vtree->update_size(current_version, vtree->get_size(current_version) + 1);
+            //in a counted tree every node on the way down gets one more key under
+            //it. a count which copies its node relinks it, so the walk goes on from
+            //the copy and ends at the live parent
+            if (counted)
+            {
+                for (auto node = root();; )
                 {
-                    auto child = node_ptr_t(new node_t(key, value, get_vc(), parent));
-                    parent->set_left(child, get_vc());
-                    inserted_node = child;
+                    node = add_count(node, 1, vc, counted_t());
+                    auto next = key < node->key ? node->get_left(vc) : node->get_right(vc);
+                    if (!next)
+                    {
+                        parent = node;
+                        break;
+                    }
+                    node = next;
                 }
             }
+            auto child = pool->create(key, value, vc);
+            if (key < parent->key)
+            {
+                parent->set_left(child, vc);
+            }
             else
             {
-                auto right = parent->get_right(get_vc());
-                if (right)
-                {
-                    right->set_value(value, get_vc());
-                    inserted_node = right;
-                }
-                else
-                {
-                    auto child = node_ptr_t(new node_t(key, value, get_vc(), parent));
-                    parent->set_right(child, get_vc());
-                    inserted_node = child;
-                }
+                parent->set_right(child, vc);
             }
-            return iterator(this, inserted_node);
+            return iterator(this, child);
         }
 
         iterator erase(iterator it)
@@ -243,68 +239,154 @@ namespace persistent
             }
 
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            read_guard guard(*vtree);
+            prepare_write();
 
-            auto& key = it->key;
+            auto vc = get_vc();
+            auto key = it->key;
             auto node = it.node;
-            auto left = node->get_left(get_vc());
-            auto right = node->get_right(get_vc());
-            auto next = node->next_node(get_vc());
-            auto bp = node->get_back_pointer(get_vc());
-            node_ptr_t new_bp = left;
-            if (!left && right)
+            vtree->update_size(current_version, vtree->get_size(current_version) - 1);
+            //every node above the erased one has a key less under it,
+            //a count which copies its node relinks it, bp ends at the live parent
+            node_ptr_t bp;
+            for (auto n = root(); n != node; n = key < bp->key ? bp->get_left(vc) : bp->get_right(vc))
             {
-                new_bp = right;
+                bp = add_count(n, -1, vc, counted_t());
             }
 
-            //new_bp child becomes parent
-            //second child subtree will be inserted in a tree again
-            if (bp)
+            auto left = node->get_left(vc);
+            auto right = node->get_right(vc);
+            auto replacement = left ? left : right;
+            if (left && right)
             {
-                //node is not root
-                auto bpl = bp->get_left(get_vc());
-                auto bpr = bp->get_right(get_vc());
-                if (bpl == node)
-                {
-                    bp->set_left(new_bp, get_vc());
-                }
-                else
+                //the successor leaves its place, which has no left child, and a node
+                //with its key and value takes the place of the erased one. grafting
+                //the right subtree under the left one instead would keep deepening the
+                //tree, and in a counted one every node on the graft's way down would
+                //get a new count
+                auto successor = right;
+                for (auto l = right->get_left(vc); l; l = successor->get_left(vc))
                 {
-                    assert(bpr == node);
-                    bp->set_right(new_bp, get_vc());
+                    add_count(successor, -1, vc, counted_t());
+                    successor = l;
                 }
-                if (new_bp)
+                //counts which copied their nodes relinked them up to the erased one
+                //and maybe past it, so the nodes which are written next are found again
+                if (successor != right)
                 {
-                    new_bp->set_back_pointer(bp, get_vc());
+                    find_with_parent(successor->key).second->set_left(successor->get_right(vc), vc);
                 }
+                auto live = find_with_parent(key);
+                node = live.first;
+                bp = live.second;
+                right = successor == right ? successor->get_right(vc) : node->get_right(vc);
+                replacement = pool->create(successor->key, successor->get_value(vc), vc,
+                                           node->get_left(vc), right, count_of(node, vc, counted_t()) - 1);
+            }
+
+            //a setter may copy a full node, later writes go to the copy
+            if (!bp)
+            {
+                vtree->update(current_version, replacement);
+            }
+            else if (key < bp->key)
+            {
+                bp->set_left(replacement, vc);
             }
             else
             {
-                //new node is root
-                vtree->update(current_version, new_bp);
-                if (new_bp)
-                {
-                    new_bp->set_back_pointer(node_ptr_t(), get_vc());
-                }
+                bp->set_right(replacement, vc);
             }
 
-            auto root_node = root();
-            if (left && right)
+            //the successor is looked up again, the writes may have copied it
+            return lower_bound(key);
+        }
+
+        //the first key which isn't less than key, end() if there is none.
+        //the bounds of another version are those of create_with_version(v)
+        iterator lower_bound(const key_type& key)
+        {
+            read_guard guard(*vtree);
+            return first_from(key, true);
+        }
+
+        //the first key which is greater than key
+        iterator upper_bound(const key_type& key)
+        {
+            read_guard guard(*vtree);
+            return first_from(key, false);
+        }
+
+        //key's node and the one after it, both end() if there is none
+        std::pair<iterator, iterator> equal_range(const key_type& key)
+        {
+            read_guard guard(*vtree);
+            return std::make_pair(first_from(key, true), first_from(key, false));
+        }
+
+        //keys from lo up to hi, hi excluded
+        range_t range(const key_type& lo, const key_type& hi)
+        {
+            read_guard guard(*vtree);
+            if (hi < lo)
+            {
+                return range_t(end(), end());
+            }
+            return range_t(first_from(lo, true), first_from(hi, true));
+        }
+
+        //replaces the contents of the current version, in one new version, with the
+        //entries of [first, last): pairs of key and value, of equal keys the last one
+        //is kept. they are built into a perfectly balanced tree in O(n), input which
+        //isn't sorted by key is sorted first
+        template <class input_iterator>
+        void assign_sorted(input_iterator first, input_iterator last)
+        {
+            typedef std::pair<key_type, value_type> entry_t;
+            std::vector<entry_t> entries;
+            for (; first != last; ++first)
+            {
+                entries.push_back(entry_t(first->first, first->second));
+            }
+            auto less = [](const entry_t& a, const entry_t& b)
             {
-                auto child2 = new_bp == left ? right : left;
-                auto parent = find_parent(child2->get_key(get_vc()), root_node, root_node);
-                assert(parent->key != key);
-                if (key < parent->key)
+                return a.first < b.first;
+            };
+            if (!std::is_sorted(entries.begin(), entries.end(), less))
+            {
+                parallel_stable_sort(entries, less);
+            }
+            size_t count = 0;
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                if (i + 1 < entries.size() && !(entries[i].first < entries[i + 1].first))
                 {
-                    parent->set_left(child2, get_vc());
+                    continue;
                 }
-                else
+                if (count != i)
                 {
-                    parent->set_right(child2, get_vc());
+                    entries[count] = std::move(entries[i]);
                 }
-                child2->set_back_pointer(parent, get_vc());
+                count++;
             }
-            return iterator(this, next);
+            entries.resize(count);
+
+            version_changed_notifier vcn(*this);
+            read_guard guard(*vtree);
+            prepare_write();
+            vtree->update(current_version, build_balanced(entries, 0, entries.size(), get_vc()));
+            vtree->update_size(current_version, entries.size());
+        }
+
+        //a tree whose one version past the empty one holds the entries of [first, last),
+        //as assign_sorted puts them
+        template <class input_iterator>
+        static binary_tree<key_type, value_type, fat_node, mod_box_size, counted> from_sorted(input_iterator first, input_iterator last,
+                                                                                     persistence_mode mode = persistence_mode::full)
+        {
+            binary_tree<key_type, value_type, fat_node, mod_box_size, counted> bst(mode);
+            bst.assign_sorted(first, last);
+            return bst;
         }
 
         std::string str()
@@ -319,8 +401,6 @@ namespace persistent
             auto it = find(key);
             if (it == end())
             {
-                version_changed_notifier vcn(*this);
-                switch_new_version();
                 it = insert(key, value_type());
             }
             return it.get_value_ref();
@@ -328,8 +408,18 @@ namespace persistent
 
         iterator begin()
         {
-            auto root_node = root();
-            return iterator(this, root_node ? root_node->leftmost_child(get_vc()) : root_node);
+            read_guard guard(*vtree);
+            std::vector<node_ptr_t> path;
+            auto node = root();
+            if (node)
+            {
+                for (auto left = node->get_left(get_vc()); left; left = node->get_left(get_vc()))
+                {
+                    path.push_back(node);
+                    node = left;
+                }
+            }
+            return iterator(this, node, std::move(path));
         }
 
         iterator end()
@@ -337,25 +427,139 @@ namespace persistent
             return iterator(this);
         }
 
+        //kept next to the root, O(1)
         size_t size()
         {
-            auto root_node = root();
-            if (!root_node)
+            return vtree->get_size(current_version);
+        }
+
+        //keys less than key, O(height), counted trees only
+        size_t rank(const key_type& key)
+        {
+            static_assert(counted, "rank() needs a counted binary_tree");
+            read_guard guard(*vtree);
+            auto vc = get_vc();
+            size_t result = 0;
+            for (auto node = root(); node; )
+            {
+                if (node->key < key)
+                {
+                    auto left = node->get_left(vc);
+                    result += (left ? left->get_count(vc) : 0) + 1;
+                    node = node->get_right(vc);
+                }
+                else
+                {
+                    node = node->get_left(vc);
+                }
+            }
+            return result;
+        }
+
+        //the key with index keys less than it, end() if there are fewer keys.
+        //O(height), counted trees only
+        iterator select(size_t index)
+        {
+            static_assert(counted, "select() needs a counted binary_tree");
+            read_guard guard(*vtree);
+            auto vc = get_vc();
+            std::vector<node_ptr_t> path;
+            for (auto node = root(); node; )
             {
-                return 0;
+                auto left = node->get_left(vc);
+                size_t left_count = left ? left->get_count(vc) : 0;
+                if (index == left_count)
+                {
+                    return iterator(this, node, std::move(path));
+                }
+                path.push_back(node);
+                if (index < left_count)
+                {
+                    node = left;
+                }
+                else
+                {
+                    index -= left_count + 1;
+                    node = node->get_right(vc);
+                }
             }
-            return root_node->size(get_vc());
+            return end();
+        }
+
+        //nodes on the longest way down from the root
+        size_t height()
+        {
+            read_guard guard(*vtree);
+            auto root_node = root();
+            return root_node ? root_node->get_height(get_vc()) : 0;
         }
 
         bool operator==(const binary_tree& bst) const
         {
             return vtree == bst.vtree && current_version == bst.current_version;
         }
+
+    private:
+        //key's node and its parent as the current version sees them now
+        std::pair<node_ptr_t, node_ptr_t> find_with_parent(const key_type& key)
+        {
+            node_ptr_t parent;
+            auto node = root();
+            while (!(node->key == key))
+            {
+                parent = node;
+                node = key < node->key ? node->get_left(get_vc()) : node->get_right(get_vc());
+            }
+            return std::make_pair(node, parent);
+        }
+
+        //the middle entry of [begin, end) over the trees of both halves
+        template <class entry_t>
+        node_ptr_t build_balanced(const std::vector<entry_t>& entries, size_t begin, size_t end, const version_context_t& vc)
+        {
+            if (begin == end)
+            {
+                return node_ptr_t();
+            }
+            size_t middle = begin + (end - begin) / 2;
+            auto left = build_balanced(entries, begin, middle, vc);
+            auto right = build_balanced(entries, middle + 1, end, vc);
+            return pool->create(entries[middle].first, entries[middle].second, vc, left, right, (uint32_t)(end - begin));
+        }
+
+        //the first node whose key isn't less than key, or is greater than key
+        //when inclusive is false, with its path from the root
+        iterator first_from(const key_type& key, bool inclusive)
+        {
+            std::vector<node_ptr_t> path;
+            node_ptr_t found;
+            size_t found_depth = 0;
+            for (auto node = root(); node; )
+            {
+                if (inclusive ? node->key < key : !(key < node->key))
+                {
+                    path.push_back(node);
+                    node = node->get_right(get_vc());
+                    continue;
+                }
+                found = node;
+                found_depth = path.size();
+                if (inclusive && !(key < node->key))
+                {
+                    break;
+                }
+                path.push_back(node);
+                node = node->get_left(get_vc());
+            }
+            //the found node's ancestors are a prefix of the path
+            path.resize(found_depth);
+            return iterator(this, found, std::move(path));
+        }
     };
 }
 
-template <class key_type, class value_type>
-std::ostream& operator<<(std::ostream& out, persistent::binary_tree<key_type, value_type>& bst)
+template <class key_type, class value_type, bool fat_node, size_t mod_box_size, bool counted>
+std::ostream& operator<<(std::ostream& out, persistent::binary_tree<key_type, value_type, fat_node, mod_box_size, counted>& bst)
 {
     out << bst.str();
     return  out;
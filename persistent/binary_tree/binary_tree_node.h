@@ -1,285 +1,129 @@
 #pragma once
+#include <cstdint>
+#include <type_traits>
 #include "key_value_entry.h"
-#include "version/version_tree.h"
-#include "version/version_context.h"
+#include "persistent/node_collector.h"
+#include "persistent/persistent_node.h"
 
 namespace persistent
 {
 
-    template <class key_type, class value_type>
+    //counted nodes keep the number of keys under them in a fourth field
+    template <class key_type, class value_type, bool fat_node = false, size_t mod_box_size = default_mod_box_size, bool counted = false>
     struct binary_tree_node :
-        std::enable_shared_from_this<binary_tree_node<key_type, value_type>>
+        std::conditional<counted,
+            persistent_node<binary_tree_node<key_type, value_type, fat_node, mod_box_size, counted>, fat_node, mod_box_size,
+                            value_type, node_link, node_link, uint32_t>,
+            persistent_node<binary_tree_node<key_type, value_type, fat_node, mod_box_size, counted>, fat_node, mod_box_size,
+                            value_type, node_link, node_link>>::type
     {
-        typedef typename binary_tree_node<key_type, value_type> node_t;
-        typedef typename std::shared_ptr<node_t> node_ptr_t;
-        typedef typename version_tree<node_ptr_t> version_tree_t;
-        typedef typename version_context<node_ptr_t> version_context_t;
-
-        enum class mod_type
-        {
-            empty_mod,
-            value_mod,
-            back_pointer_mod,
-            left_mod,
-            right_mod
-        };
-
-        struct mod_box_entry
-        {
-            mod_type type;
-            version v;
-            value_type value;
-            node_ptr_t back_pointer;
-            node_ptr_t left;
-            node_ptr_t right;
-
-            mod_box_entry() :
-                type(mod_type::empty_mod)
-            {
-            }
-
-            mod_box_entry(mod_type type, version v, const value_type& new_value) :
-                type(type),
-                v(v)
-            {
-                switch (type)
-                {
-                case mod_type::value_mod:
-                    value = new_value;
-                    break;
-                }
-            }
-
-            mod_box_entry(mod_type type, version v, const std::shared_ptr<binary_tree_node>& new_value) :
-                type(type),
-                v(v)
-            {
-                switch (type)
-                {
-                case mod_type::back_pointer_mod:
-                    back_pointer = new_value;
-                    break;
-                case mod_type::left_mod:
-                    left = new_value;
-                    break;
-                case mod_type::right_mod:
-                    right = new_value;
-                    break;
-                }
-            }
-
-            bool is_empty() const
-            {
-                return type == mod_type::empty_mod;
-            }
+        typedef typename binary_tree_node<key_type, value_type, fat_node, mod_box_size, counted> node_t;
+        typedef typename std::conditional<counted,
+            persistent_node<node_t, fat_node, mod_box_size, value_type, node_link, node_link, uint32_t>,
+            persistent_node<node_t, fat_node, mod_box_size, value_type, node_link, node_link>>::type base_t;
+        typedef typename base_t::node_ptr_t node_ptr_t;
+        typedef typename base_t::node_pool_t node_pool_t;
+        typedef typename base_t::version_tree_t version_tree_t;
+        typedef typename base_t::version_context_t version_context_t;
+        typedef typename base_t::mod_box_entry mod_box_entry;
+        typedef typename base_t::mod_box_t mod_box_t;
+
+        enum field
+        {
+            value_field,
+            left_field,
+            right_field,
+            //keys in the subtree of the node, itself included, for counted nodes
+            count_field
         };
 
         const key_type key;
-        value_type value;
-
-        std::shared_ptr<binary_tree_node> back_pointer;
-        std::shared_ptr<binary_tree_node> left;
-        std::shared_ptr<binary_tree_node> right;
-        std::vector<mod_box_entry> mod_box;
 
-        binary_tree_node(const key_type& key, const value_type& value,
+        //created by node_pool::create, which passes self. nodes which aren't
+        //counted ignore count
+        binary_tree_node(const node_ptr_t& self,
+                         const key_type& key, const value_type& value,
                          const version_context_t& vc,
-                         node_ptr_t back_pointer = node_ptr_t(),
-                         node_ptr_t left = node_ptr_t(),
-                         node_ptr_t right = node_ptr_t(),
-                         const std::vector<mod_box_entry>& mod_box = std::vector<mod_box_entry>(2 * (2 + 1 + 1))) :
-            key(key),
-            value(value),
-            back_pointer(back_pointer),
-            left(left),
-            right(right),
-            mod_box(mod_box)
-        {
-            register_callbacks<value_type>(this->value, vc);
-        }
-
-        mod_box_entry* get_lastest_mod(mod_type type, std::vector<mod_box_entry>& box, version v)
-        {
-            version v_last;
-            mod_box_entry* me_ptr = nullptr;
-            for (auto& mod_entry : box)
-            {
-                if (mod_entry.type == type && mod_entry.v <= v)
-                {
-                    if (v_last < mod_entry.v)
-                    {
-                        v_last = mod_entry.v;
-                        me_ptr = &mod_entry;
-                    }
-                }
-            }
-            return me_ptr;
-        }
-
-        template <class T>
-        void add_mod_generic(mod_type type, version v, const T& new_value)
-        {
-            assert(!is_mod_box_full());
-            size_t empty_index = 0;
-            for (size_t i = 0; i < mod_box.size(); i++)
-            {
-                if (mod_box[i].is_empty())
-                {
-                    empty_index = i;
-                    break;
-                }
-            }
-            mod_box[empty_index] = mod_box_entry(type, v, new_value);
-        }
-
-        void add_mod(mod_type type, version v, const value_type& value)
+                         const node_ptr_t& left = node_ptr_t(),
+                         const node_ptr_t& right = node_ptr_t(),
+                         uint32_t count = 1) :
+            base_t(self),
+            key(key)
         {
-            add_mod_generic(type, v, value);
+            this->template init<value_field>(value);
+            this->template init<left_field>(left);
+            this->template init<right_field>(right);
+            init_count(count, std::integral_constant<bool, counted>());
+            this->register_fields(vc);
         }
 
-        void add_mod(mod_type type, version v, const node_ptr_t& node)
+        //the copy split makes
+        binary_tree_node(const node_ptr_t& self, binary_tree_node& from, const version_context_t& vc) :
+            base_t(self, from, vc),
+            key(from.key)
         {
-            add_mod_generic(type, v, node);
         }
 
-        bool is_mod_box_full() const
+        void init_count(uint32_t count, std::true_type)
         {
-            return mod_box.back().type != mod_type::empty_mod;
+            this->template init<count_field>(count);
         }
 
-        node_ptr_t split(const version_context_t& vc)
+        void init_count(uint32_t count, std::false_type)
         {
-            assert(is_mod_box_full());
-            auto old_mod_box = mod_box;
-            mod_box.resize(mod_box.size() / 2);
-
-            auto& new_value = get_value(mod_box, vc);
-            auto new_back_pointer = get_back_pointer(mod_box, vc);
-            auto new_left = get_left(mod_box, vc);
-            auto new_right = get_right(mod_box, vc);
-
-            std::vector<mod_box_entry> new_mod_box(old_mod_box.begin() + old_mod_box.size() / 2, old_mod_box.end());
-            new_mod_box.resize(old_mod_box.size());
-            mod_box = old_mod_box;
-
-            auto new_node = node_ptr_t(new node_t(key, new_value, vc, new_back_pointer, new_left, new_right, new_mod_box));
-            return new_node;
         }
 
-        static void update_node(node_ptr_t old_node, node_ptr_t new_node, const version_context_t& vc)
+        //points the parent of this node in vc.v at new_node. nodes keep no link to
+        //their parent, it is the last node on the way down from the root to key.
+        //a parent which is full splits in turn, the copies start empty so it ends
+        void replace_with(const node_ptr_t& new_node, const version_context_t& vc)
         {
-            auto back_pointer = new_node->get_back_pointer(vc);
-            if (back_pointer)
+            auto parent = vc.vtree->get_value(vc.v);
+            if (parent == this->self)
             {
-                if (back_pointer->get_left(vc) == old_node)
-                {
-                    back_pointer->set_left(new_node, vc);
-                }
-                else
-                {
-                    assert(back_pointer->get_right(vc) == old_node);
-                    back_pointer->set_right(new_node, vc);
-                }
-            }
-            auto left = new_node->get_left(vc);
-            if (left)
-            {
-                left->set_back_pointer(new_node, vc);
-            }
-            auto right = new_node->get_right(vc);
-            if (right)
-            {
-                right->set_back_pointer(new_node, vc);
-            }
-        }
-
-        node_ptr_t split_and_update(const version_context_t& vc)
-        {
-            auto new_node = split(vc);
-            //todo: call get_back_pointer
-            if (!back_pointer)
-            {
-                //node is root so root pointer of version v should be updated
                 vc.vtree->update(vc.v, new_node);
+                return;
             }
-            update_node(shared_from_this(), new_node, vc);
-            return new_node;
-        }
-
-        //use SFINAE to find out whether or not value_type is persistent structure
-        template <class T>
-        void register_callbacks(typename T::persistent_type& val, const version_context_t& vc)
-        {
-            auto& pds = (persistent_structure<value_type>&)val;
-            pds.set_parent_version(vc.v);
-            pds.add_parent(vc.vs,
-                [&, vc](version node_version, const value_type& new_value)
+            while (parent)
+            {
+                bool go_left = key < parent->key;
+                auto child = go_left ? parent->get_left(vc) : parent->get_right(vc);
+                if (child == this->self)
                 {
-                    auto root = vc.vtree->get_value(vc.v);
-                    auto new_version = vc.vtree->insert(vc.v, root);
-                    set_value(new_value, version_context_t(vc.vs, new_version, vc.vtree));
-                    return new_version;
-                });
-        }
-
-        template <class T>
-        void register_callbacks(T& val, const version_context_t& vc)
-        {
+                    if (go_left)
+                    {
+                        parent->set_left(new_node, vc);
+                    }
+                    else
+                    {
+                        parent->set_right(new_node, vc);
+                    }
+                    return;
+                }
+                parent = child;
+            }
         }
 
-
-        void set_value(const value_type& val, const version_context_t& vc)
+        //setters return the node which holds the field in vc.v from now on,
+        //a copy of this one when its box was full
+        node_ptr_t set_value(const value_type& val, const version_context_t& vc)
         {
-            if (!is_mod_box_full())
-            {
-                add_mod(mod_type::value_mod, vc.v, val);
-            }
-            else
-            {
-                node_ptr_t new_node = split_and_update(vc);
-                new_node->set_value(val, vc);
-            }
-            auto& inserted_val = get_value(vc);
-            register_callbacks<value_type>(inserted_val, vc);
+            return this->template set_field<value_field>(val, vc);
         }
 
-        void set_back_pointer(const node_ptr_t& bp, const version_context_t& vc)
+        node_ptr_t set_left(const node_ptr_t& l, const version_context_t& vc)
         {
-            if (!is_mod_box_full())
-            {
-                add_mod(mod_type::back_pointer_mod, vc.v, bp);
-            }
-            else
-            {
-                node_ptr_t new_node = split_and_update(vc);
-                new_node->set_back_pointer(bp, vc);
-            }
+            return this->template set_field<left_field>(l, vc);
         }
 
-        void set_left(const node_ptr_t& l, const version_context_t& vc)
+        node_ptr_t set_right(const node_ptr_t& r, const version_context_t& vc)
         {
-            if (!is_mod_box_full())
-            {
-                add_mod(mod_type::left_mod, vc.v, l);
-            }
-            else
-            {
-                node_ptr_t new_node = split_and_update(vc);
-                new_node->set_left(l, vc);
-            }
+            return this->template set_field<right_field>(r, vc);
         }
 
-        void set_right(const node_ptr_t& r, const version_context_t& vc)
+        node_ptr_t set_count(uint32_t count, const version_context_t& vc)
         {
-            if (!is_mod_box_full())
-            {
-                add_mod(mod_type::right_mod, vc.v, r);
-            }
-            else
-            {
-                node_ptr_t new_node = split_and_update(vc);
-                new_node->set_right(r, vc);
-            }
+            return this->template set_field<count_field>(count, vc);
         }
 
         const key_type& get_key(const version_context_t& vc) const
@@ -289,57 +133,20 @@ namespace persistent
 
         value_type& get_value(const version_context_t& vc)
         {
-            mod_box_entry* m = get_lastest_mod(mod_type::value_mod, mod_box, vc.v);
-            value_type& val = !m ? value : m->value;
-            register_callbacks<value_type>(val, vc);
-            return val;
-        }
-
-        node_ptr_t get_back_pointer(const version_context_t& vc)
-        {
-            mod_box_entry* m = get_lastest_mod(mod_type::back_pointer_mod, mod_box, vc.v);
-            return !m ? back_pointer : m->back_pointer;
+            return this->template get_field<value_field>(vc);
         }
 
         node_ptr_t get_left(const version_context_t& vc)
         {
-            mod_box_entry* m = get_lastest_mod(mod_type::left_mod, mod_box, vc.v);
-            return !m ? left : m->left;
+            return this->template get_field<left_field>(vc);
         }
 
         node_ptr_t get_right(const version_context_t& vc)
         {
-            mod_box_entry* m = get_lastest_mod(mod_type::right_mod, mod_box, vc.v);
-            return !m ? right : m->right;
-        }
-
-        value_type& get_value(std::vector<mod_box_entry>& box, const version_context_t& vc)
-        {
-            mod_box_entry* m = get_lastest_mod(mod_type::value_mod, box, vc.v);
-            value_type& val = !m ? value : m->value;
-            register_callbacks<value_type>(val, vc);
-            return val;
+            return this->template get_field<right_field>(vc);
         }
 
-        node_ptr_t get_back_pointer(std::vector<mod_box_entry>& box, const version_context_t& vc)
-        {
-            mod_box_entry* m = get_lastest_mod(mod_type::back_pointer_mod, box, vc.v);
-            return !m ? back_pointer : m->back_pointer;
-        }
-
-        node_ptr_t get_left(std::vector<mod_box_entry>& box, const version_context_t& vc)
-        {
-            mod_box_entry* m = get_lastest_mod(mod_type::left_mod, box, vc.v);
-            return !m ? left : m->left;
-        }
-
-        node_ptr_t get_right(std::vector<mod_box_entry>& box, const version_context_t& vc)
-        {
-            mod_box_entry* m = get_lastest_mod(mod_type::right_mod, box, vc.v);
-            return !m ? right : m->right;
-        }
-
-        size_t get_height(const version_context_t& vc) const
+        size_t get_height(const version_context_t& vc)
         {
             auto left = get_left(vc);
             auto right = get_right(vc);
@@ -348,48 +155,10 @@ namespace persistent
             return (left_height > right_height) ? left_height + 1 : right_height + 1;
         }
 
-        size_t size(const version_context_t& vc)
-        {
-            auto left = get_left(vc);
-            auto right = get_right(vc);
-            size_t left_size = left ? left->size(vc) : 0;
-            size_t right_size = right ? right->size(vc) : 0;
-            return left_size + right_size + 1;
-        }
-
-        node_ptr_t next_parent(const version_context_t& vc)
+        //keys in the subtree, kept up to date by the tree as it changes
+        uint32_t get_count(const version_context_t& vc)
         {
-            auto parent = get_back_pointer(vc);
-            if (!parent)
-            {
-                return node_ptr_t();
-            }
-
-            if (parent->get_left(vc).get() == this)
-            {
-                return parent;
-            }
-            return parent->next_parent(vc);
-        }
-
-        node_ptr_t leftmost_child(const version_context_t& vc)
-        {
-            auto left = get_left(vc);
-            if (!left)
-            {
-                return shared_from_this();
-            }
-            return left->leftmost_child(vc);
-        }
-
-        node_ptr_t next_node(const version_context_t& vc)
-        {
-            if (auto right = get_right(vc))
-            {
-                return right->leftmost_child(vc);
-            }
-
-            return next_parent(vc);
+            return this->template get_field<count_field>(vc);
         }
 
         std::string str(const version_context_t& vc)
@@ -1,3 +1,4 @@
+#pragma once
 namespace persistent
 {
     template <class key_type, class value_type>
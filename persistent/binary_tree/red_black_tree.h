@@ -0,0 +1,527 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include <cassert>
+#include "persistent/persistent_structure.h"
+#include "persistent/node_collector.h"
+#include "version.h"
+#include "red_black_tree_node.h"
+#include "tree_iterator.h"
+#include "utils.h"
+
+namespace persistent
+{
+    //binary search tree kept balanced by red-black rules, so find, insert and
+    //erase are O(log n) in every version whatever order keys come in.
+    //rotations and colors are versioned fields like the links, nodes don't
+    //link to their parent, operations keep the path down from the root instead
+    template <class key_type, class value_type, bool fat_node = false, size_t mod_box_size = default_mod_box_size>
+    class red_black_tree :
+        public persistent_structure<red_black_tree<key_type, value_type, fat_node, mod_box_size>>
+    {
+    public:
+        typedef typename red_black_tree_node<key_type, value_type, fat_node, mod_box_size> node_t;
+        typedef typename node_t::node_ptr_t node_ptr_t;
+        typedef typename version_context<node_ptr_t> version_context_t;
+        //held through an operation, so writers on other branches may run meanwhile
+        //but version labels don't move under its comparisons
+        typedef typename version_tree<node_ptr_t>::read_guard read_guard;
+        typedef typename tree_iterator<red_black_tree<key_type, value_type, fat_node, mod_box_size>, node_ptr_t, key_type, value_type> iterator;
+        friend iterator;
+
+    private:
+        //nodes from the root down to the one an operation works on, as vc.v sees them now
+        typedef std::vector<node_ptr_t> path_t;
+
+        std::shared_ptr<version_tree<node_ptr_t>> vtree;
+        //nodes of every version in vtree, shared with trees created from this one
+        std::shared_ptr<node_pool<node_t>> pool;
+        version current_version;
+
+        node_ptr_t root() const
+        {
+            return vtree->get_value(current_version);
+        }
+
+        version_context_t get_vc()
+        {
+            return version_context_t(this, get_version(), vtree.get());
+        }
+
+        bool is_red(const node_ptr_t& node)
+        {
+            return node && node->is_red(get_vc());
+        }
+
+        //the nodes from the root down to key's node, or to the node key would hang from
+        path_t find_path(const key_type& key)
+        {
+            path_t path;
+            for (auto node = root(); node; node = key < node->key ? node->get_left(get_vc()) : node->get_right(get_vc()))
+            {
+                path.push_back(node);
+                if (node->key == key)
+                {
+                    break;
+                }
+            }
+            return path;
+        }
+
+        //node takes the place of path[depth], as a copy of it or as another subtree:
+        //links the parent to node, parents which are copied by the write are linked in turn
+        void relink(path_t& path, size_t depth, node_ptr_t node)
+        {
+            auto vc = get_vc();
+            while (true)
+            {
+                auto old = path[depth];
+                path[depth] = node;
+                if (depth == 0)
+                {
+                    vtree->update(current_version, node);
+                    return;
+                }
+                auto parent = path[depth - 1];
+                auto live = parent->get_left(vc) == old ? parent->write_left(node, vc) : parent->write_right(node, vc);
+                if (live == parent)
+                {
+                    return;
+                }
+                node = live;
+                depth--;
+            }
+        }
+
+        void set_child(path_t& path, size_t depth, bool left, const node_ptr_t& child)
+        {
+            auto node = path[depth];
+            auto live = left ? node->write_left(child, get_vc()) : node->write_right(child, get_vc());
+            if (live != node)
+            {
+                relink(path, depth, live);
+            }
+        }
+
+        void paint(path_t& path, size_t depth, bool red)
+        {
+            auto node = path[depth];
+            if (node->is_red(get_vc()) == red)
+            {
+                return;
+            }
+            auto live = node->write_red(red, get_vc());
+            if (live != node)
+            {
+                relink(path, depth, live);
+            }
+        }
+
+        //paints a child of path.back(), which isn't on the path
+        void paint_child(path_t& path, const node_ptr_t& child, bool red)
+        {
+            path.push_back(child);
+            paint(path, path.size() - 1, red);
+            path.pop_back();
+        }
+
+        //turns path[depth] down to the left, or to the right, and its other child takes
+        //its place. the path then ends at that child followed by the node turned down
+        void rotate(path_t& path, size_t depth, bool left)
+        {
+            auto vc = get_vc();
+            auto node = path[depth];
+            auto child = left ? node->get_right(vc) : node->get_left(vc);
+            auto inner = left ? child->get_left(vc) : child->get_right(vc);
+            //the node goes under child, so a copy made here is linked there and not in its old place
+            node = left ? node->write_right(inner, vc) : node->write_left(inner, vc);
+            child = left ? child->write_left(node, vc) : child->write_right(node, vc);
+            relink(path, depth, child);
+            path.resize(depth + 1);
+            path.push_back(node);
+        }
+
+        //path ends at a red node which may have a red parent
+        void fix_insert(path_t& path)
+        {
+            auto vc = get_vc();
+            size_t depth = path.size() - 1;
+            //the root is black, so a red parent has a parent
+            while (depth >= 2 && is_red(path[depth - 1]))
+            {
+                auto parent = path[depth - 1];
+                auto grandparent = path[depth - 2];
+                bool parent_left = grandparent->get_left(vc) == parent;
+                auto uncle = parent_left ? grandparent->get_right(vc) : grandparent->get_left(vc);
+                if (is_red(uncle))
+                {
+                    //the grandparent passes its black down to both children
+                    paint(path, depth - 1, false);
+                    path.resize(depth - 1);
+                    paint_child(path, uncle, false);
+                    paint(path, depth - 2, true);
+                    depth -= 2;
+                    continue;
+                }
+
+                bool node_left = parent->get_left(vc) == path[depth];
+                if (node_left != parent_left)
+                {
+                    //the node goes up in its parent's place, so the red pair lines up
+                    rotate(path, depth - 1, parent_left);
+                }
+                paint(path, depth - 1, false);
+                paint(path, depth - 2, true);
+                rotate(path, depth - 2, !parent_left);
+                break;
+            }
+            path.resize(1);
+            paint(path, 0, false);
+        }
+
+        //a black node was taken from the left, or the right, of path.back(), and node
+        //is in its place now, possibly none. that side is a black short of the other
+        void fix_erase(path_t& path, bool left, node_ptr_t node)
+        {
+            auto vc = get_vc();
+            while (!path.empty() && !is_red(node))
+            {
+                size_t depth = path.size() - 1;
+                auto sibling = left ? path[depth]->get_right(vc) : path[depth]->get_left(vc);
+                if (is_red(sibling))
+                {
+                    //the sibling goes up, its black child becomes the sibling
+                    paint_child(path, sibling, false);
+                    paint(path, depth, true);
+                    rotate(path, depth, left);
+                    depth++;
+                    sibling = left ? path[depth]->get_right(vc) : path[depth]->get_left(vc);
+                }
+
+                auto near_child = left ? sibling->get_left(vc) : sibling->get_right(vc);
+                auto far_child = left ? sibling->get_right(vc) : sibling->get_left(vc);
+                if (!is_red(near_child) && !is_red(far_child))
+                {
+                    //the sibling's side gives up a black too, the parent carries the shortage
+                    paint_child(path, sibling, true);
+                    node = path[depth];
+                    path.pop_back();
+                    if (!path.empty())
+                    {
+                        left = path.back()->get_left(vc) == node;
+                    }
+                    continue;
+                }
+
+                if (!is_red(far_child))
+                {
+                    //the near child goes up in the sibling's place, so the far child is red
+                    path.push_back(sibling);
+                    paint(path, depth + 1, true);
+                    paint_child(path, near_child, false);
+                    rotate(path, depth + 1, !left);
+                    sibling = path[depth + 1];
+                    path.resize(depth + 1);
+                    far_child = left ? sibling->get_right(vc) : sibling->get_left(vc);
+                }
+
+                //the sibling takes the parent's place and color, both below it turn black
+                path.push_back(sibling);
+                paint(path, depth + 1, path[depth]->is_red(vc));
+                paint_child(path, far_child, false);
+                path.pop_back();
+                paint(path, depth, false);
+                rotate(path, depth, left);
+                return;
+            }
+
+            if (is_red(node))
+            {
+                path.push_back(node);
+                paint(path, path.size() - 1, false);
+            }
+        }
+
+        //the first node whose key isn't less than key, with its path from the root
+        iterator first_not_less(const key_type& key)
+        {
+            path_t path;
+            node_ptr_t found;
+            size_t found_depth = 0;
+            for (auto node = root(); node; )
+            {
+                if (node->key < key)
+                {
+                    path.push_back(node);
+                    node = node->get_right(get_vc());
+                    continue;
+                }
+                found = node;
+                found_depth = path.size();
+                if (!(key < node->key))
+                {
+                    break;
+                }
+                path.push_back(node);
+                node = node->get_left(get_vc());
+            }
+            //the found node's ancestors are a prefix of the path
+            path.resize(found_depth);
+            return iterator(this, found, std::move(path));
+        }
+
+    public:
+        red_black_tree(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<node_ptr_t>(node_ptr_t(), mode)),
+            pool(new node_pool<node_t>()),
+            current_version(vtree->root_version())
+        {
+        }
+
+        red_black_tree(red_black_tree& tree, version v) :
+            vtree(tree.vtree),
+            pool(tree.pool),
+            current_version(v)
+        {
+        }
+
+        red_black_tree<key_type, value_type, fat_node, mod_box_size> create_with_version(version v) override
+        {
+            return red_black_tree<key_type, value_type, fat_node, mod_box_size>(*this, v);
+        }
+
+        void set_version(const version& v)
+        {
+            current_version = v;
+            version_changed();
+        }
+
+        version get_version() const
+        {
+            return current_version;
+        }
+
+        void switch_new_version() override
+        {
+            auto root_node = root();
+            auto new_version = vtree->insert(current_version, root_node);
+            current_version = new_version;
+        }
+
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            return collect_nodes(*vtree, *pool);
+        }
+
+        //nodes and mod entries of every version, before garbage is collected
+        node_stats get_node_stats()
+        {
+            read_guard guard(*vtree);
+            return count_nodes(*pool);
+        }
+
+        iterator find(const key_type& key)
+        {
+            read_guard guard(*vtree);
+            auto path = find_path(key);
+            if (path.empty() || !(path.back()->key == key))
+            {
+                return end();
+            }
+            auto node = path.back();
+            path.pop_back();
+            return iterator(this, node, std::move(path));
+        }
+
+        iterator insert(const key_type& key, const value_type& value)
+        {
+            version_changed_notifier vcn(*this);
+            read_guard guard(*vtree);
+            auto path = find_path(key);
+            if (!path.empty() && path.back()->key == key)
+            {
+                auto node = path.back();
+                if (!(node->get_value(get_vc()) == value))
+                {
+                    prepare_write();
+                    node = node->write_value(value, get_vc());
+                    if (node != path.back())
+                    {
+                        relink(path, path.size() - 1, node);
+                    }
+                }
+                path.pop_back();
+                return iterator(this, node, std::move(path));
+            }
+
+            prepare_write();
+            vtree->update_size(current_version, vtree->get_size(current_version) + 1);
+            if (path.empty())
+            {
+                auto node = pool->create(key, value, get_vc(), false);
+                vtree->update(current_version, node);
+                return iterator(this, node, std::move(path));
+            }
+            auto node = pool->create(key, value, get_vc());
+            set_child(path, path.size() - 1, key < path.back()->key, node);
+            path.push_back(node);
+            fix_insert(path);
+            //rotations may have moved or copied the new node
+            return find(key);
+        }
+
+        iterator erase(iterator it)
+        {
+            if (it == end())
+            {
+                return it;
+            }
+
+            version_changed_notifier vcn(*this);
+            read_guard guard(*vtree);
+            prepare_write();
+            auto vc = get_vc();
+            vtree->update_size(current_version, vtree->get_size(current_version) - 1);
+
+            auto key = it->key;
+            auto path = find_path(key);
+            size_t depth = path.size() - 1;
+            auto node = path[depth];
+            auto left = node->get_left(vc);
+            auto right = node->get_right(vc);
+            bool removed_red;
+            bool removed_left;
+            node_ptr_t child;
+            if (left && right)
+            {
+                //the successor leaves its place, which has no left child, and a node
+                //with its key and value takes the place of the erased one
+                path.push_back(right);
+                for (auto l = right->get_left(vc); l; l = l->get_left(vc))
+                {
+                    path.push_back(l);
+                }
+                auto successor = path.back();
+                removed_red = successor->is_red(vc);
+                removed_left = path.size() - 1 != depth + 1;
+                child = successor->get_right(vc);
+                path.pop_back();
+                set_child(path, path.size() - 1, removed_left, child);
+
+                node = path[depth];
+                auto replacement = pool->create(successor->key, successor->get_value(vc), vc, node->is_red(vc),
+                                                node->get_left(vc), node->get_right(vc));
+                relink(path, depth, replacement);
+            }
+            else
+            {
+                child = left ? left : right;
+                removed_red = node->is_red(vc);
+                path.pop_back();
+                removed_left = !path.empty() && path.back()->get_left(vc) == node;
+                if (path.empty())
+                {
+                    vtree->update(current_version, child);
+                }
+                else
+                {
+                    set_child(path, path.size() - 1, removed_left, child);
+                }
+            }
+            if (!removed_red)
+            {
+                fix_erase(path, removed_left, child);
+            }
+
+            //the successor is looked up again, the writes may have copied it
+            return first_not_less(key);
+        }
+
+        std::string str()
+        {
+            read_guard guard(*vtree);
+            std::ostringstream oss;
+            if (auto root_node = root())
+            {
+                utils::print_tree(root_node, get_vc(), oss);
+            }
+            return oss.str();
+        }
+
+        value_type& operator[](const key_type& key)
+        {
+            auto it = find(key);
+            if (it == end())
+            {
+                it = insert(key, value_type());
+            }
+            return it.get_value_ref();
+        }
+
+        iterator begin()
+        {
+            read_guard guard(*vtree);
+            path_t path;
+            auto node = root();
+            if (node)
+            {
+                for (auto left = node->get_left(get_vc()); left; left = node->get_left(get_vc()))
+                {
+                    path.push_back(node);
+                    node = left;
+                }
+            }
+            return iterator(this, node, std::move(path));
+        }
+
+        iterator end()
+        {
+            return iterator(this);
+        }
+
+        //kept next to the root, O(1)
+        size_t size()
+        {
+            return vtree->get_size(current_version);
+        }
+
+        //nodes on the longest way down from the root, at most 2 log2(n + 1)
+        size_t height()
+        {
+            read_guard guard(*vtree);
+            auto root_node = root();
+            return root_node ? root_node->get_height(get_vc()) : 0;
+        }
+
+        //black nodes on every way down from the root, null links counted, or 0
+        //when the root is red or the colors below break the red-black rules
+        size_t black_height()
+        {
+            read_guard guard(*vtree);
+            auto root_node = root();
+            if (!root_node)
+            {
+                return 1;
+            }
+            return root_node->is_red(get_vc()) ? 0 : root_node->get_black_height(get_vc());
+        }
+
+        bool operator==(const red_black_tree& tree) const
+        {
+            return vtree == tree.vtree && current_version == tree.current_version;
+        }
+    };
+}
+
+template <class key_type, class value_type, bool fat_node, size_t mod_box_size>
+std::ostream& operator<<(std::ostream& out, persistent::red_black_tree<key_type, value_type, fat_node, mod_box_size>& tree)
+{
+    out << tree.str();
+    return  out;
+}
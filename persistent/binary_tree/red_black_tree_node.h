@@ -0,0 +1,186 @@
+#pragma once
+#include "key_value_entry.h"
+#include "persistent/node_collector.h"
+#include "persistent/persistent_node.h"
+
+namespace persistent
+{
+    template <class key_type, class value_type, bool fat_node = false, size_t mod_box_size = default_mod_box_size>
+    struct red_black_tree_node :
+        persistent_node<red_black_tree_node<key_type, value_type, fat_node, mod_box_size>, fat_node, mod_box_size,
+                        value_type, node_link, node_link, bool>
+    {
+        typedef typename red_black_tree_node<key_type, value_type, fat_node, mod_box_size> node_t;
+        typedef typename persistent_node<node_t, fat_node, mod_box_size, value_type, node_link, node_link, bool> base_t;
+        typedef typename base_t::node_ptr_t node_ptr_t;
+        typedef typename base_t::node_pool_t node_pool_t;
+        typedef typename base_t::version_tree_t version_tree_t;
+        typedef typename base_t::version_context_t version_context_t;
+        typedef typename base_t::mod_box_entry mod_box_entry;
+        typedef typename base_t::mod_box_t mod_box_t;
+
+        enum field
+        {
+            value_field,
+            left_field,
+            right_field,
+            red_field
+        };
+
+        const key_type key;
+
+        //created by node_pool::create, which passes self. new nodes are red
+        red_black_tree_node(const node_ptr_t& self,
+                            const key_type& key, const value_type& value,
+                            const version_context_t& vc,
+                            bool red = true,
+                            const node_ptr_t& left = node_ptr_t(),
+                            const node_ptr_t& right = node_ptr_t()) :
+            base_t(self),
+            key(key)
+        {
+            this->template init<value_field>(value);
+            this->template init<left_field>(left);
+            this->template init<right_field>(right);
+            this->template init<red_field>(red);
+            this->register_fields(vc);
+        }
+
+        //the copy split makes
+        red_black_tree_node(const node_ptr_t& self, red_black_tree_node& from, const version_context_t& vc) :
+            base_t(self, from, vc),
+            key(from.key)
+        {
+        }
+
+        //points the parent of this node in vc.v at new_node, the parent is the last
+        //node on the way down from the root to key. rebalancing writes through the
+        //write_ methods and links copies itself, this serves set_value
+        void replace_with(const node_ptr_t& new_node, const version_context_t& vc)
+        {
+            auto parent = vc.vtree->get_value(vc.v);
+            if (parent == this->self)
+            {
+                vc.vtree->update(vc.v, new_node);
+                return;
+            }
+            while (parent)
+            {
+                bool go_left = key < parent->key;
+                auto child = go_left ? parent->get_left(vc) : parent->get_right(vc);
+                if (child == this->self)
+                {
+                    if (go_left)
+                    {
+                        parent->set_left(new_node, vc);
+                    }
+                    else
+                    {
+                        parent->set_right(new_node, vc);
+                    }
+                    return;
+                }
+                parent = child;
+            }
+        }
+
+        node_ptr_t set_value(const value_type& val, const version_context_t& vc)
+        {
+            return this->template set_field<value_field>(val, vc);
+        }
+
+        node_ptr_t set_left(const node_ptr_t& l, const version_context_t& vc)
+        {
+            return this->template set_field<left_field>(l, vc);
+        }
+
+        node_ptr_t set_right(const node_ptr_t& r, const version_context_t& vc)
+        {
+            return this->template set_field<right_field>(r, vc);
+        }
+
+        //writers return the node which holds the field in vc.v from now on,
+        //the caller links it in place of this one when it is a copy
+        node_ptr_t write_value(const value_type& val, const version_context_t& vc)
+        {
+            return this->template write_field<value_field>(val, vc);
+        }
+
+        node_ptr_t write_left(const node_ptr_t& l, const version_context_t& vc)
+        {
+            return this->template write_field<left_field>(l, vc);
+        }
+
+        node_ptr_t write_right(const node_ptr_t& r, const version_context_t& vc)
+        {
+            return this->template write_field<right_field>(r, vc);
+        }
+
+        node_ptr_t write_red(bool red, const version_context_t& vc)
+        {
+            return this->template write_field<red_field>(red, vc);
+        }
+
+        const key_type& get_key(const version_context_t& vc) const
+        {
+            return key;
+        }
+
+        value_type& get_value(const version_context_t& vc)
+        {
+            return this->template get_field<value_field>(vc);
+        }
+
+        node_ptr_t get_left(const version_context_t& vc)
+        {
+            return this->template get_field<left_field>(vc);
+        }
+
+        node_ptr_t get_right(const version_context_t& vc)
+        {
+            return this->template get_field<right_field>(vc);
+        }
+
+        bool is_red(const version_context_t& vc)
+        {
+            return this->template get_field<red_field>(vc);
+        }
+
+        size_t get_height(const version_context_t& vc)
+        {
+            auto left = get_left(vc);
+            auto right = get_right(vc);
+            size_t left_height = left ? left->get_height(vc) : 0;
+            size_t right_height = right ? right->get_height(vc) : 0;
+            return (left_height > right_height) ? left_height + 1 : right_height + 1;
+        }
+
+        //black nodes on every way down from this one, the null link below the
+        //leaves counted as one. 0 when a red node has a red child or two ways
+        //down have different black heights
+        size_t get_black_height(const version_context_t& vc)
+        {
+            auto left = get_left(vc);
+            auto right = get_right(vc);
+            bool red = is_red(vc);
+            if (red && ((left && left->is_red(vc)) || (right && right->is_red(vc))))
+            {
+                return 0;
+            }
+            size_t left_height = left ? left->get_black_height(vc) : 1;
+            size_t right_height = right ? right->get_black_height(vc) : 1;
+            if (left_height == 0 || left_height != right_height)
+            {
+                return 0;
+            }
+            return red ? left_height : left_height + 1;
+        }
+
+        std::string str(const version_context_t& vc)
+        {
+            std::ostringstream oss;
+            oss << get_key(vc) << (is_red(vc) ? " red" : " black");
+            return oss.str();
+        }
+    };
+}
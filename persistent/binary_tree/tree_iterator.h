@@ -0,0 +1,141 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "key_value_entry.h"
+
+namespace persistent
+{
+    //iterator of a search tree whose nodes don't link to their parent. it keeps
+    //the nodes from the root down to node's parent and climbs them on ++, an
+    //iterator made from a single node finds them by node's key when it is first moved
+    template <class tree_t, class node_ptr_t, class key_type, class value_type>
+    class tree_iterator
+    {
+        friend tree_t;
+
+        tree_t* tree;
+        node_ptr_t node;
+        std::vector<node_ptr_t> path;
+        bool has_path;
+
+        std::shared_ptr<key_value_entry<key_type, value_type>> kve;
+
+        template <class version_context_t>
+        void load_entry(const version_context_t& vc)
+        {
+            kve.reset();
+            if (node)
+            {
+                kve = std::shared_ptr<key_value_entry<key_type, value_type>>
+                    (new key_value_entry<key_type, value_type>(node->get_key(vc), node->get_value(vc)));
+            }
+        }
+
+        template <class version_context_t>
+        void find_path(const version_context_t& vc)
+        {
+            path.clear();
+            for (auto n = tree->root(); n != node; n = node->key < n->key ? n->get_left(vc) : n->get_right(vc))
+            {
+                path.push_back(n);
+            }
+            has_path = true;
+        }
+
+        value_type& get_value_ref() const
+        {
+            typename tree_t::read_guard guard(*tree->vtree);
+            return node->get_value(tree->get_vc());
+        }
+
+    public:
+        tree_iterator(tree_t* tree, node_ptr_t node = node_ptr_t()) :
+            tree(tree),
+            node(node),
+            has_path(false)
+        {
+            if (node)
+            {
+                typename tree_t::read_guard guard(*tree->vtree);
+                load_entry(tree->get_vc());
+            }
+        }
+
+        tree_iterator(tree_t* tree, node_ptr_t node, std::vector<node_ptr_t>&& path) :
+            tree(tree),
+            node(node),
+            path(std::move(path)),
+            has_path(true)
+        {
+            if (node)
+            {
+                typename tree_t::read_guard guard(*tree->vtree);
+                load_entry(tree->get_vc());
+            }
+        }
+
+        tree_iterator& operator++()
+        {
+            typename tree_t::read_guard guard(*tree->vtree);
+            auto vc = tree->get_vc();
+            if (!has_path)
+            {
+                find_path(vc);
+            }
+            if (auto right = node->get_right(vc))
+            {
+                path.push_back(node);
+                node = right;
+                for (auto left = node->get_left(vc); left; left = node->get_left(vc))
+                {
+                    path.push_back(node);
+                    node = left;
+                }
+            }
+            else
+            {
+                //the next node is the first ancestor reached from its left subtree
+                auto child = node;
+                node = node_ptr_t();
+                while (!path.empty())
+                {
+                    auto parent = path.back();
+                    path.pop_back();
+                    if (parent->get_left(vc) == child)
+                    {
+                        node = parent;
+                        break;
+                    }
+                    child = parent;
+                }
+            }
+            load_entry(vc);
+            return *this;
+        }
+
+        key_value_entry<key_type, value_type>& operator*()
+        {
+            return *kve;
+        }
+
+        bool operator==(const tree_iterator& it) const
+        {
+            return node == it.node && get_version() == it.get_version();
+        }
+
+        bool operator!=(const tree_iterator& it) const
+        {
+            return !operator==(it);
+        }
+
+        key_value_entry<key_type, value_type>* operator->() const
+        {
+            return kve.get();
+        }
+
+        version get_version() const
+        {
+            return tree->get_version();
+        }
+    };
+}
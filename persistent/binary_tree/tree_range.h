@@ -0,0 +1,34 @@
+#pragma once
+
+namespace persistent
+{
+    //keys of a tree from first up to last, last excluded, for range-based for.
+    //the bounds are found once, walking the range costs what ++ does
+    template <class iterator>
+    struct tree_range
+    {
+        iterator first;
+        iterator last;
+
+        tree_range(const iterator& first, const iterator& last) :
+            first(first),
+            last(last)
+        {
+        }
+
+        iterator begin() const
+        {
+            return first;
+        }
+
+        iterator end() const
+        {
+            return last;
+        }
+
+        bool empty() const
+        {
+            return first == last;
+        }
+    };
+}
@@ -1,5 +1,7 @@
 #include "version/version.h"
 #include "binary_tree/binary_tree.h"
+#include "binary_tree/red_black_tree.h"
+#include "b_plus_tree/b_plus_tree.h"
 #include "linked_list/linked_list.h"
 #include "vector/vector.h"
 #include "vector/fat_vector.h"
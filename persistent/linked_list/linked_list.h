@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 #include "persistent/persistent_structure.h"
+#include "persistent/node_collector.h"
 #include "version.h"
 #include "linked_list_node.h"
 #include "vector/vector.h"
@@ -8,17 +9,20 @@
 
 namespace persistent
 {
-    template <class value_type, bool fat_node = false>
+    template <class value_type, bool fat_node = false, size_t mod_box_size = default_mod_box_size>
     class linked_list :
-        public persistent_structure<linked_list<value_type, fat_node>>
+        public persistent_structure<linked_list<value_type, fat_node, mod_box_size>>
     {
     public:
-        typedef typename linked_list_node<value_type, fat_node> node_t;
-        typedef typename std::shared_ptr<node_t> node_ptr_t;
+        typedef typename linked_list_node<value_type, fat_node, mod_box_size> node_t;
+        typedef typename node_t::node_ptr_t node_ptr_t;
         typedef typename version_context<node_ptr_t> version_context_t;
+        typedef typename version_tree<node_ptr_t>::read_guard read_guard;
 
     //private:
         std::shared_ptr<version_tree<node_ptr_t>> vtree;
+        //nodes of every version in vtree, shared with lists created from this one
+        std::shared_ptr<node_pool<node_t>> pool;
         version current_version;
 
         node_ptr_t head() const
@@ -34,7 +38,7 @@ namespace persistent
     public:
         struct iterator
         {
-            linked_list<value_type, fat_node>* l;
+            linked_list<value_type, fat_node, mod_box_size>* l;
             node_ptr_t node;
 
             std::shared_ptr<value_type> kve;
@@ -46,18 +50,20 @@ namespace persistent
 
             friend class linked_list;
 
-            iterator(linked_list<value_type, fat_node>* l, node_ptr_t node = node_ptr_t()) :
+            iterator(linked_list<value_type, fat_node, mod_box_size>* l, node_ptr_t node = node_ptr_t()) :
                 l(l),
                 node(node)
             {
                 if (node)
                 {
+                    read_guard guard(*l->vtree);
                     kve = std::shared_ptr<value_type>(new value_type(node->get_value(l->get_vc())));
                 }
             }
 
             iterator& operator++()
             {
+                read_guard guard(*l->vtree);
                 auto vc = l->get_vc();
                 node = node->get_next(vc);
                 kve.reset();
@@ -95,21 +101,23 @@ namespace persistent
             }
         };
 
-        linked_list() :
-            vtree(new version_tree<node_ptr_t>),
+        linked_list(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<node_ptr_t>(node_ptr_t(), mode)),
+            pool(new node_pool<node_t>()),
             current_version(vtree->root_version())
         {
         }
 
         linked_list(linked_list& l, version v) :
             vtree(l.vtree),
+            pool(l.pool),
             current_version(v)
         {
         }
 
-        linked_list<value_type, fat_node> create_with_version(version v)
+        linked_list<value_type, fat_node, mod_box_size> create_with_version(version v)
         {
-            return linked_list<value_type, fat_node>(*this, v);
+            return linked_list<value_type, fat_node, mod_box_size>(*this, v);
         }
 
         void set_version(const version& v)
@@ -130,6 +138,17 @@ namespace persistent
             current_version = new_version;
         }
 
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            return collect_nodes(*vtree, *pool);
+        }
+
         std::string str()
         {
             std::ostringstream oss;
@@ -148,14 +167,10 @@ namespace persistent
             return iterator(this);
         }
 
+        //kept next to the head, O(1)
         size_t size()
         {
-            auto head_node = head();
-            if (!head_node)
-            {
-                return 0;
-            }
-            return head_node->size(get_vc());
+            return vtree->get_size(current_version);
         }
 
         void pop_front()
@@ -167,26 +182,33 @@ namespace persistent
             }
 
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            read_guard guard(*vtree);
+            prepare_write();
 
             auto prev = head_node->get_prev(get_vc());
             auto next = head_node->get_next(get_vc());
             assert(!prev);
             if (!prev)
             {
-                next->set_prev(node_ptr_t(), get_vc());
+                if (next)
+                {
+                    next = next->set_prev(node_ptr_t(), get_vc());
+                }
                 vtree->update(current_version, next);
+                vtree->update_size(current_version, vtree->get_size(current_version) - 1);
             }
         }
 
         void push_front(const value_type& value)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            read_guard guard(*vtree);
+            prepare_write();
 
             auto head_node = head();
-            auto new_head_node = node_ptr_t(new node_t(value, get_vc(), node_ptr_t(), head_node));
+            auto new_head_node = pool->create(value, get_vc(), node_ptr_t(), head_node);
             vtree->update(get_version(), new_head_node);
+            vtree->update_size(current_version, vtree->get_size(current_version) + 1);
 
             if (head_node)
             {
@@ -197,22 +219,25 @@ namespace persistent
         iterator erase(iterator it)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            read_guard guard(*vtree);
+            prepare_write();
 
             auto head_node = head();
             assert(it.get_version() == get_version());
 
             auto vc = get_vc();
+            vtree->update_size(current_version, vtree->get_size(current_version) - 1);
             auto erased_node = it.node;
             auto prev = erased_node->get_prev(vc);
             auto next = erased_node->get_next(vc);
+            //a setter may copy a full node, later writes go to the copy
             if (prev)
             {
-                prev->set_next(next, vc);
+                prev = prev->set_next(next, vc);
             }
             if (next)
             {
-                next->set_prev(prev, vc);
+                next = next->set_prev(prev, vc);
             }
             if (!prev)
             {
@@ -237,8 +262,8 @@ namespace persistent
     };
 }
 
-template <class value_type, bool fat_node>
-std::ostream& operator<<(std::ostream& out, persistent::linked_list<value_type, fat_node>& l)
+template <class value_type, bool fat_node, size_t mod_box_size>
+std::ostream& operator<<(std::ostream& out, persistent::linked_list<value_type, fat_node, mod_box_size>& l)
 {
     out << l.str();
     return  out;
@@ -2,14 +2,38 @@
 #include <memory>
 #include <list>
 #include "persistent.h"
+#include "benchmark/version_tree_benchmark.h"
+#include "benchmark/persistence_mode_benchmark.h"
+#include "benchmark/concurrency_benchmark.h"
+#include "benchmark/mod_lookup_benchmark.h"
+#include "benchmark/node_size_benchmark.h"
+#include "benchmark/mod_box_size_benchmark.h"
+#include "benchmark/split_benchmark.h"
+#include "benchmark/node_layout_benchmark.h"
+#include "benchmark/fat_node_benchmark.h"
+#include "benchmark/trivial_value_benchmark.h"
+#include "benchmark/mod_traffic_benchmark.h"
+#include "benchmark/balanced_tree_benchmark.h"
+#include "benchmark/b_plus_tree_benchmark.h"
+#include "benchmark/bulk_load_benchmark.h"
 using namespace std;
 
 int main()
 {
-    persistent::vector<int> v;
-    persistent::version ver0 = v.get_version();
-    v.push_back(1);
-    persistent::version ver1 = v.get_version();
-    v.set_version(ver0);
+    benchmark::run_version_tree_benchmark();
+    benchmark::run_version_creation_benchmark();
+    benchmark::run_persistence_mode_benchmark();
+    benchmark::run_concurrency_benchmark();
+    benchmark::run_mod_lookup_benchmark();
+    benchmark::run_node_size_benchmark();
+    benchmark::run_mod_box_size_benchmark();
+    benchmark::run_split_benchmark();
+    benchmark::run_node_layout_benchmark();
+    benchmark::run_fat_node_benchmark();
+    benchmark::run_trivial_value_benchmark();
+    benchmark::run_mod_traffic_benchmark();
+    benchmark::run_balanced_tree_benchmark();
+    benchmark::run_b_plus_tree_benchmark();
+    benchmark::run_bulk_load_benchmark();
     return 0;
 }
@@ -8,20 +8,48 @@ namespace persistent
         binary_tree<key_type, value_type> bst;
 
     public:
-        typedef typename binary_tree<key_type, value_type>::version version_t;
+        typedef persistent::version version_t;
         typedef typename binary_tree<key_type, value_type>::iterator iterator;
+        typedef typename binary_tree<key_type, value_type>::range_t range_t;
 
-        map() = default;
-
-        value_type& operator[](const key_type& key)
+        //what operator[] gives: reading finds the key, a missing one reads as
+        //value_type() and isn't inserted. assigning inserts through the tree, so
+        //the write makes a version like insert does and older ones keep their value
+        class value_proxy
         {
-            auto it = bst.find(key);
-            if (it == bst.end())
+            map* owner;
+            key_type key;
+
+        public:
+            value_proxy(map* owner, const key_type& key) :
+                owner(owner),
+                key(key)
+            {
+            }
+
+            operator value_type() const
             {
-                auto it = bst.insert(key, value_type());
-                return it->value;
+                auto it = owner->bst.find(key);
+                return it == owner->bst.end() ? value_type() : it->value;
             }
-            return it->value;
+
+            value_proxy& operator=(const value_type& value)
+            {
+                owner->bst.insert(key, value);
+                return *this;
+            }
+
+            value_proxy& operator=(const value_proxy& proxy)
+            {
+                return *this = (value_type)proxy;
+            }
+        };
+
+        map() = default;
+
+        value_proxy operator[](const key_type& key)
+        {
+            return value_proxy(this, key);
         }
 
         iterator find(const key_type& key)
@@ -29,6 +57,27 @@ namespace persistent
             return bst.find(key);
         }
 
+        iterator lower_bound(const key_type& key)
+        {
+            return bst.lower_bound(key);
+        }
+
+        iterator upper_bound(const key_type& key)
+        {
+            return bst.upper_bound(key);
+        }
+
+        std::pair<iterator, iterator> equal_range(const key_type& key)
+        {
+            return bst.equal_range(key);
+        }
+
+        //keys from lo up to hi, hi excluded
+        range_t range(const key_type& lo, const key_type& hi)
+        {
+            return bst.range(lo, hi);
+        }
+
         iterator begin()
         {
             return bst.begin();
@@ -38,5 +87,20 @@ namespace persistent
         {
             return bst.end();
         }
+
+        size_t size()
+        {
+            return bst.size();
+        }
+
+        version_t get_version() const
+        {
+            return bst.get_version();
+        }
+
+        void set_version(const version_t& v)
+        {
+            bst.set_version(v);
+        }
     };
 }
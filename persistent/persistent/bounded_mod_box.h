@@ -0,0 +1,88 @@
+#pragma once
+#include <utility>
+#include "persistent/inline_mod_box.h"
+#include "persistent/mod_index.h"
+#include "persistent/node_collector.h"
+
+namespace persistent
+{
+    //mod box of a node-copying node: capacity slots inside the node and an index
+    //of them per field. a full box makes its node split, entries never move while
+    //the node is in use, so writers on different branches can share the node
+    template <class entry_t, size_t fields, size_t capacity>
+    class bounded_mod_box
+    {
+        inline_mod_box<entry_t, capacity> slots;
+        mod_index<fields> index;
+
+        void reindex()
+        {
+            index.rebuild(slots, [](const entry_t& mod_entry)
+            {
+                return mod_entry.is_empty() ? fields : mod_entry.field();
+            });
+        }
+
+    public:
+        //entry of field which v sees, the one of its nearest ancestor
+        entry_t* find(size_t field, const version& v)
+        {
+            int slot = index.find(field, v);
+            return slot == index.not_found ? nullptr : &slots[slot];
+        }
+
+        bool is_full() const
+        {
+            return !slots.back().is_empty();
+        }
+
+        //adds an entry, a field written again in the same version overwrites
+        //its entry. false when the box is full
+        bool try_add(entry_t&& mod_entry)
+        {
+            size_t field = mod_entry.field();
+            int slot = index.find_exact(field, mod_entry.v);
+            if (slot == index.not_found)
+            {
+                if (is_full())
+                {
+                    return false;
+                }
+                slot = 0;
+                while (!slots[slot].is_empty())
+                {
+                    slot++;
+                }
+                index.insert(field, mod_entry.v, slot);
+            }
+            slots[slot] = std::move(mod_entry);
+            return true;
+        }
+
+        //moves or drops entries of versions released in vtree
+        template <class value_type>
+        void prune(const version_tree<value_type>& vtree)
+        {
+            collapse_mods(slots, vtree);
+            reindex();
+        }
+
+        template <class F>
+        void for_each(F f)
+        {
+            for (auto& mod_entry : slots)
+            {
+                if (!mod_entry.is_empty())
+                {
+                    f(mod_entry);
+                }
+            }
+        }
+
+        //bytes outside of the node
+        size_t heap_usage() const
+        {
+            return slots.heap_usage() + index.memory_usage();
+        }
+    };
+}
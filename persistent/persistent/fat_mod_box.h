@@ -0,0 +1,313 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <cassert>
+#include <algorithm>
+#include <type_traits>
+#include "version/version.h"
+#include "persistent/node_collector.h"
+
+namespace persistent
+{
+    //mod box of a fat node: it never fills, so its node is never copied.
+    //entries are stored in chunks and never move while the node is in use, so
+    //a reader can use the entry it found after letting go of the node's lock,
+    //and writers on different branches can share the node. each field keeps
+    //its entries' slots sorted by the begin label of their version, relabeling
+    //keeps that order. a read binary searches them for the last entry which
+    //begins no later than its version, then climbs from it to the nearest one
+    //which encloses its version: the entries which enclose that one, and no
+    //other, are the candidates. every entry links to the nearest entry which
+    //encloses it and to one further up (jump pointers), so the climb takes
+    //O(log n) steps whatever branches lie between
+    template <class entry_t, size_t fields>
+    class fat_mod_box
+    {
+        static const uint32_t no_slot = UINT32_MAX;
+
+        //where a slot's entry is in the version tree of its field's entries
+        struct link
+        {
+            version_id v;
+            uint32_t parent;
+            uint32_t jump;
+            uint32_t depth;
+        };
+
+        //the version is kept next to the slot, so binary searches don't visit the chunks
+        struct ordered_slot
+        {
+            version_id v;
+            uint32_t slot;
+        };
+
+        struct slot_t
+        {
+            link l;
+            typename std::aligned_storage<sizeof(entry_t), std::alignment_of<entry_t>::value>::type cell;
+        };
+
+        //chunk c holds 2^(c + 1) slots, so at most half of the storage is unused
+        std::vector<std::unique_ptr<slot_t[]>> chunks;
+        uint32_t stored;
+        std::array<std::vector<ordered_slot>, fields> order;
+
+        static size_t chunk_of(uint32_t slot)
+        {
+            size_t c = 0;
+            while (((size_t)4 << c) <= (size_t)slot + 2)
+            {
+                c++;
+            }
+            return c;
+        }
+
+        slot_t& slot_at(uint32_t slot) const
+        {
+            size_t c = chunk_of(slot);
+            return chunks[c][slot + 2 - ((size_t)2 << c)];
+        }
+
+        entry_t& at(uint32_t slot)
+        {
+            return reinterpret_cast<entry_t&>(slot_at(slot).cell);
+        }
+
+        const link& link_of(uint32_t slot) const
+        {
+            return slot_at(slot).l;
+        }
+
+        //keeps the entry where it is, a new chunk is added when the last one is full
+        uint32_t store(entry_t&& mod_entry, const link& l)
+        {
+            size_t c = chunk_of(stored);
+            if (c == chunks.size())
+            {
+                chunks.emplace_back(new slot_t[(size_t)2 << c]);
+            }
+            slot_at(stored).l = l;
+            new (&at(stored)) entry_t(std::move(mod_entry));
+            return stored++;
+        }
+
+        void clear()
+        {
+            for (uint32_t slot = 0; slot < stored; slot++)
+            {
+                at(slot).~entry_t();
+            }
+            chunks.clear();
+            stored = 0;
+            for (auto& field_order : order)
+            {
+                field_order.clear();
+            }
+        }
+
+        static label_type begin_label(const label_type* labels, version_id v)
+        {
+            return labels[begin_node(v)];
+        }
+
+        static label_type end_label(const label_type* labels, version_id v)
+        {
+            return labels[end_node(v)];
+        }
+
+        //a slot under parent, which is no_slot when no entry encloses it
+        link make_link(version_id v, uint32_t parent) const
+        {
+            link l = { v, parent, parent, 0 };
+            if (parent != no_slot)
+            {
+                auto& p = link_of(parent);
+                l.depth = p.depth + 1;
+                if (p.jump != no_slot && link_of(p.jump).jump != no_slot &&
+                    p.depth - link_of(p.jump).depth == link_of(p.jump).depth - link_of(link_of(p.jump).jump).depth)
+                {
+                    l.jump = link_of(p.jump).jump;
+                }
+            }
+            return l;
+        }
+
+        //first entry of field_order which begins after label
+        static size_t upper_bound(const std::vector<ordered_slot>& field_order, const label_type* labels, label_type label)
+        {
+            size_t lo = 0;
+            size_t hi = field_order.size();
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2;
+                if (begin_label(labels, field_order[mid].v) <= label)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+        //the nearest entry enclosing v among the first i of field_order, no_slot if none
+        uint32_t enclosing(const std::vector<ordered_slot>& field_order, size_t i, const label_type* labels, const version& v) const
+        {
+            if (i == 0)
+            {
+                return no_slot;
+            }
+            label_type end = end_label(labels, v.get_id());
+            auto encloses = [&](uint32_t slot)
+            {
+                return end <= end_label(labels, link_of(slot).v);
+            };
+            uint32_t slot = field_order[i - 1].slot;
+            while (slot != no_slot && !encloses(slot))
+            {
+                //the entries up to a jump which doesn't enclose v don't either
+                uint32_t jump = link_of(slot).jump;
+                slot = jump != no_slot && !encloses(jump) ? jump : link_of(slot).parent;
+            }
+            return slot;
+        }
+
+    public:
+        fat_mod_box() :
+            stored(0)
+        {
+        }
+
+        fat_mod_box(const fat_mod_box&) = delete;
+        fat_mod_box& operator=(const fat_mod_box&) = delete;
+
+        ~fat_mod_box()
+        {
+            clear();
+        }
+
+        //entry of field which v sees, the one of its nearest ancestor
+        entry_t* find(size_t field, const version& v)
+        {
+            auto& field_order = order[field];
+            const label_type* labels = v.get_label_table();
+            size_t i = upper_bound(field_order, labels, begin_label(labels, v.get_id()));
+            uint32_t slot = enclosing(field_order, i, labels, v);
+            return slot == no_slot ? nullptr : &at(slot);
+        }
+
+        bool is_full() const
+        {
+            return false;
+        }
+
+        //adds an entry, a field written again in the same version overwrites its entry.
+        //versions are written while they have no descendants, so the new entry
+        //encloses none of the others and their links stay as they are
+        bool try_add(entry_t&& mod_entry)
+        {
+            auto& field_order = order[mod_entry.field()];
+            const label_type* labels = mod_entry.v.get_label_table();
+            version_id v = mod_entry.v.get_id();
+            size_t i = upper_bound(field_order, labels, begin_label(labels, v));
+            if (i > 0 && field_order[i - 1].v == v)
+            {
+                at(field_order[i - 1].slot) = std::move(mod_entry);
+                return true;
+            }
+            assert(i == field_order.size() || end_label(labels, v) < begin_label(labels, field_order[i].v));
+            auto l = make_link(v, enclosing(field_order, i, labels, mod_entry.v));
+            ordered_slot o = { v, store(std::move(mod_entry), l) };
+            field_order.insert(field_order.begin() + i, o);
+            return true;
+        }
+
+        //moves or drops entries of versions released in vtree,
+        //heirs take the place of a released version, so entries are sorted and linked again
+        template <class value_type>
+        void prune(const version_tree<value_type>& vtree)
+        {
+            bool released = false;
+            for (uint32_t slot = 0; slot < stored; slot++)
+            {
+                released = released || vtree.is_released(version(nullptr, link_of(slot).v));
+            }
+            if (!released)
+            {
+                return;
+            }
+
+            std::array<std::vector<entry_t>, fields> kept;
+            for (size_t field = 0; field < fields; field++)
+            {
+                for (auto& o : order[field])
+                {
+                    kept[field].push_back(std::move(at(o.slot)));
+                }
+            }
+            clear();
+            for (auto& field_entries : kept)
+            {
+                collapse_mods(field_entries, vtree);
+                field_entries.erase(std::remove_if(field_entries.begin(), field_entries.end(), [](const entry_t& mod_entry)
+                {
+                    return mod_entry.is_empty();
+                }), field_entries.end());
+                if (field_entries.empty())
+                {
+                    continue;
+                }
+                const label_type* labels = field_entries[0].v.get_label_table();
+                std::sort(field_entries.begin(), field_entries.end(), [&](const entry_t& a, const entry_t& b)
+                {
+                    return begin_label(labels, a.v.get_id()) < begin_label(labels, b.v.get_id());
+                });
+
+                //entries which enclose the next one, innermost on top
+                auto& field_order = order[field_entries[0].field()];
+                std::vector<uint32_t> open;
+                for (auto& mod_entry : field_entries)
+                {
+                    version_id v = mod_entry.v.get_id();
+                    while (!open.empty() && end_label(labels, link_of(open.back()).v) < end_label(labels, v))
+                    {
+                        open.pop_back();
+                    }
+                    auto l = make_link(v, open.empty() ? no_slot : open.back());
+                    open.push_back(store(std::move(mod_entry), l));
+                    ordered_slot o = { v, open.back() };
+                    field_order.push_back(o);
+                }
+            }
+        }
+
+        template <class F>
+        void for_each(F f)
+        {
+            for (uint32_t slot = 0; slot < stored; slot++)
+            {
+                f(at(slot));
+            }
+        }
+
+        //bytes outside of the node
+        size_t heap_usage() const
+        {
+            size_t bytes = chunks.capacity() * sizeof(std::unique_ptr<slot_t[]>);
+            for (size_t c = 0; c < chunks.size(); c++)
+            {
+                bytes += ((size_t)2 << c) * sizeof(slot_t);
+            }
+            for (auto& field_order : order)
+            {
+                bytes += field_order.capacity() * sizeof(ordered_slot);
+            }
+            return bytes;
+        }
+    };
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <memory>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+
+namespace persistent
+{
+    //slots of a node's mod box when a structure doesn't choose
+    static const size_t default_mod_box_size = 2 * (2 + 1 + 1);
+
+    //mod box kept inside its node: capacity slots, unused ones hold empty entries.
+    //a box only grows past capacity when garbage collection copies an entry to
+    //several heirs, it moves to the heap then
+    template <class entry_t, size_t capacity>
+    class inline_mod_box
+    {
+        std::array<entry_t, capacity> slots;
+        std::unique_ptr<std::vector<entry_t>> spilled;
+
+    public:
+        typedef entry_t* iterator;
+        typedef const entry_t* const_iterator;
+
+        inline_mod_box()
+        {
+        }
+
+        inline_mod_box(const inline_mod_box&) = delete;
+        inline_mod_box& operator=(const inline_mod_box&) = delete;
+
+        size_t size() const
+        {
+            return spilled ? spilled->size() : capacity;
+        }
+
+        bool is_inline() const
+        {
+            return !spilled;
+        }
+
+        iterator begin()
+        {
+            return spilled ? spilled->data() : slots.data();
+        }
+
+        iterator end()
+        {
+            return begin() + size();
+        }
+
+        const_iterator begin() const
+        {
+            return spilled ? spilled->data() : slots.data();
+        }
+
+        const_iterator end() const
+        {
+            return begin() + size();
+        }
+
+        entry_t& operator[](size_t i)
+        {
+            return begin()[i];
+        }
+
+        const entry_t& operator[](size_t i) const
+        {
+            return begin()[i];
+        }
+
+        entry_t& back()
+        {
+            return end()[-1];
+        }
+
+        const entry_t& back() const
+        {
+            return end()[-1];
+        }
+
+        //replaces the entries, a box never gets smaller than capacity
+        template <class It>
+        void assign(It first, It last)
+        {
+            size_t n = (size_t)std::distance(first, last);
+            if (n <= capacity)
+            {
+                std::copy(first, last, slots.begin());
+                std::fill(slots.begin() + n, slots.end(), entry_t());
+                spilled.reset();
+                return;
+            }
+            auto entries = std::unique_ptr<std::vector<entry_t>>(new std::vector<entry_t>(first, last));
+            std::fill(slots.begin(), slots.end(), entry_t());
+            spilled = std::move(entries);
+        }
+
+        //bytes outside of the node
+        size_t heap_usage() const
+        {
+            return spilled ? sizeof(std::vector<entry_t>) + spilled->capacity() * sizeof(entry_t) : 0;
+        }
+    };
+}
@@ -0,0 +1,278 @@
+#pragma once
+#include <new>
+#include <tuple>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+#include "version/version.h"
+
+namespace persistent
+{
+    //size and alignment of the biggest of a node's field types,
+    //and whether all of them are trivially copyable
+    template <class... field_types>
+    struct field_storage_traits;
+
+    template <>
+    struct field_storage_traits<>
+    {
+        static const size_t size = 1;
+        static const size_t align = 1;
+        static const bool trivial = true;
+    };
+
+    template <class head, class... tail>
+    struct field_storage_traits<head, tail...>
+    {
+        typedef typename field_storage_traits<tail...> rest;
+        static const size_t size = sizeof(head) > rest::size ? sizeof(head) : rest::size;
+        static const size_t align = std::alignment_of<head>::value > rest::align ? std::alignment_of<head>::value : rest::align;
+        static const bool trivial = std::is_trivially_copyable<head>::value && rest::trivial;
+    };
+
+    //copies, moves and destroys the field of a runtime index in raw storage
+    template <class... field_types>
+    struct field_dispatch;
+
+    template <>
+    struct field_dispatch<>
+    {
+        static void copy(size_t field, void* to, const void* from)
+        {
+        }
+
+        static void move(size_t field, void* to, void* from)
+        {
+        }
+
+        static void destroy(size_t field, void* data)
+        {
+        }
+    };
+
+    template <class head, class... tail>
+    struct field_dispatch<head, tail...>
+    {
+        static void copy(size_t field, void* to, const void* from)
+        {
+            if (field == 0)
+            {
+                new (to) head(*static_cast<const head*>(from));
+                return;
+            }
+            field_dispatch<tail...>::copy(field - 1, to, from);
+        }
+
+        static void move(size_t field, void* to, void* from)
+        {
+            if (field == 0)
+            {
+                new (to) head(std::move(*static_cast<head*>(from)));
+                return;
+            }
+            field_dispatch<tail...>::move(field - 1, to, from);
+        }
+
+        static void destroy(size_t field, void* data)
+        {
+            if (field == 0)
+            {
+                static_cast<head*>(data)->~head();
+                return;
+            }
+            field_dispatch<tail...>::destroy(field - 1, data);
+        }
+    };
+
+    //fields and payload of an entry, v goes first so a small payload fills the padding after tag
+    template <class... field_types>
+    struct mod_entry_layout
+    {
+        version v;
+        //0 for an empty entry, the index of the field plus one otherwise
+        uint32_t tag;
+
+    protected:
+        typedef typename field_storage_traits<field_types...> storage_traits;
+
+        typename std::aligned_storage<storage_traits::size, storage_traits::align>::type payload;
+
+        mod_entry_layout() :
+            tag(0)
+        {
+        }
+
+        mod_entry_layout(uint32_t tag, version v) :
+            v(v),
+            tag(tag)
+        {
+        }
+    };
+
+    //copies and destroys whichever field the entry holds
+    template <bool trivial, class... field_types>
+    struct mod_entry_storage :
+        mod_entry_layout<field_types...>
+    {
+    private:
+        typedef typename mod_entry_layout<field_types...> layout_t;
+        typedef typename field_dispatch<field_types...> dispatch_t;
+
+        void destroy()
+        {
+            if (this->tag)
+            {
+                dispatch_t::destroy(this->tag - 1, &this->payload);
+            }
+            this->tag = 0;
+        }
+
+    protected:
+        mod_entry_storage()
+        {
+        }
+
+        mod_entry_storage(uint32_t tag, version v) :
+            layout_t(tag, v)
+        {
+        }
+
+    public:
+        mod_entry_storage(const mod_entry_storage& other) :
+            layout_t(other.tag, other.v)
+        {
+            if (other.tag)
+            {
+                dispatch_t::copy(other.tag - 1, &this->payload, &other.payload);
+            }
+        }
+
+        mod_entry_storage(mod_entry_storage&& other) :
+            layout_t(other.tag, other.v)
+        {
+            if (other.tag)
+            {
+                dispatch_t::move(other.tag - 1, &this->payload, &other.payload);
+            }
+        }
+
+        mod_entry_storage& operator=(const mod_entry_storage& other)
+        {
+            if (this != &other)
+            {
+                destroy();
+                if (other.tag)
+                {
+                    dispatch_t::copy(other.tag - 1, &this->payload, &other.payload);
+                }
+                this->tag = other.tag;
+                this->v = other.v;
+            }
+            return *this;
+        }
+
+        mod_entry_storage& operator=(mod_entry_storage&& other)
+        {
+            if (this != &other)
+            {
+                destroy();
+                if (other.tag)
+                {
+                    dispatch_t::move(other.tag - 1, &this->payload, &other.payload);
+                }
+                this->tag = other.tag;
+                this->v = other.v;
+            }
+            return *this;
+        }
+
+        ~mod_entry_storage()
+        {
+            destroy();
+        }
+    };
+
+    //trivially copyable fields are copied as raw bytes and never destroyed,
+    //so the entry is trivially copyable too and boxes of them move with memmove
+    template <class... field_types>
+    struct mod_entry_storage<true, field_types...> :
+        mod_entry_layout<field_types...>
+    {
+    protected:
+        mod_entry_storage()
+        {
+        }
+
+        mod_entry_storage(uint32_t tag, version v) :
+            mod_entry_layout<field_types...>(tag, v)
+        {
+        }
+    };
+
+    //entry of a mod box: the version which wrote it and the new content of one
+    //field of a node. fields share storage, so an entry is as large as the
+    //biggest field type rather than of every field together
+    template <class... field_types>
+    struct mod_entry :
+        mod_entry_storage<field_storage_traits<field_types...>::trivial, field_types...>
+    {
+    private:
+        typedef typename mod_entry_storage<field_storage_traits<field_types...>::trivial, field_types...> storage_t;
+
+        mod_entry(uint32_t tag, version v) :
+            storage_t(tag, v)
+        {
+        }
+
+    public:
+        template <size_t field>
+        struct field_type
+        {
+            typedef typename std::tuple_element<field, std::tuple<field_types...>>::type type;
+        };
+
+        mod_entry()
+        {
+        }
+
+        template <size_t field>
+        static mod_entry make(version v, const typename field_type<field>::type& new_value)
+        {
+            mod_entry entry((uint32_t)field + 1, v);
+            new (&entry.payload) typename field_type<field>::type(new_value);
+            return entry;
+        }
+
+        bool is_empty() const
+        {
+            return this->tag == 0;
+        }
+
+        size_t field() const
+        {
+            assert(!is_empty());
+            return this->tag - 1;
+        }
+
+        template <size_t field>
+        typename field_type<field>::type& get()
+        {
+            assert(this->tag == field + 1);
+            return *reinterpret_cast<typename field_type<field>::type*>(&this->payload);
+        }
+
+        template <size_t field>
+        const typename field_type<field>::type& get() const
+        {
+            assert(this->tag == field + 1);
+            return *reinterpret_cast<const typename field_type<field>::type*>(&this->payload);
+        }
+
+        //payload of whichever field the entry holds
+        void* data()
+        {
+            return &this->payload;
+        }
+    };
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include "version/version.h"
+
+namespace persistent
+{
+    //per field index of a mod box kept as a structure of arrays: version ids of
+    //a field's entries sorted by begin label, next to their slots in the box.
+    //relabeling keeps the order of labels, so the index stays sorted and a read
+    //binary searches the label table instead of scanning the whole box
+    template <size_t fields>
+    class mod_index
+    {
+        std::vector<version_id> ids;
+        std::vector<uint16_t> slots;
+        //entries of field f are [starts[f], starts[f + 1])
+        std::array<uint16_t, fields + 1> starts;
+
+        //first entry of field which begins after label
+        size_t upper_bound(size_t field, const label_type* labels, label_type label) const
+        {
+            size_t lo = starts[field];
+            size_t hi = starts[field + 1];
+            while (lo < hi)
+            {
+                size_t mid = (lo + hi) / 2;
+                if (labels[begin_node(ids[mid])] <= label)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            return lo;
+        }
+
+    public:
+        static const int not_found = -1;
+
+        mod_index()
+        {
+            starts.fill(0);
+        }
+
+        //slot of the entry of field which v sees, the one of its nearest ancestor
+        int find(size_t field, const version& v) const
+        {
+            const label_type* labels = v.get_label_table();
+            size_t i = upper_bound(field, labels, labels[begin_node(v.get_id())]);
+            label_type end = labels[end_node(v.get_id())];
+            //entries before v either enclose it or end before it starts,
+            //enclosing ones are ancestors and the last of them is the nearest
+            while (i-- > starts[field])
+            {
+                if (end <= labels[end_node(ids[i])])
+                {
+                    return slots[i];
+                }
+            }
+            return not_found;
+        }
+
+        //slot of the entry of field written in v itself
+        int find_exact(size_t field, const version& v) const
+        {
+            for (size_t i = starts[field]; i < starts[field + 1]; i++)
+            {
+                if (ids[i] == v.get_id())
+                {
+                    return slots[i];
+                }
+            }
+            return not_found;
+        }
+
+        void insert(size_t field, const version& v, size_t slot)
+        {
+            assert(slot <= UINT16_MAX);
+            const label_type* labels = v.get_label_table();
+            size_t i = upper_bound(field, labels, labels[begin_node(v.get_id())]);
+            ids.insert(ids.begin() + i, v.get_id());
+            slots.insert(slots.begin() + i, (uint16_t)slot);
+            for (size_t f = field + 1; f <= fields; f++)
+            {
+                starts[f]++;
+            }
+        }
+
+        //field_of maps an entry to its field, or to fields when it is empty
+        template <class box_t, class F>
+        void rebuild(const box_t& box, F field_of)
+        {
+            ids.clear();
+            slots.clear();
+            starts.fill(0);
+            ids.reserve(box.size());
+            slots.reserve(box.size());
+            for (size_t slot = 0; slot < box.size(); slot++)
+            {
+                size_t field = field_of(box[slot]);
+                if (field < fields)
+                {
+                    insert(field, box[slot].v, slot);
+                }
+            }
+        }
+
+        size_t memory_usage() const
+        {
+            return ids.capacity() * sizeof(version_id) + slots.capacity() * sizeof(uint16_t);
+        }
+    };
+}
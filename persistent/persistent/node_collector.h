@@ -0,0 +1,141 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include "version/version_tree.h"
+#include "persistent/node_pool.h"
+
+namespace persistent
+{
+    //rewrites a mod box after versions were released in vtree: an entry of a released
+    //version moves to every heir of it which doesn't see a newer entry of the same field,
+    //and is dropped when no heir needs it.
+    //a box can grow past its size when an entry is copied to several heirs
+    template <class box_t, class value_type>
+    void collapse_mods(box_t& box, const version_tree<value_type>& vtree)
+    {
+        typedef typename std::decay<decltype(*box.begin())>::type entry_t;
+        auto is_released = [&](const entry_t& mod_entry)
+        {
+            return !mod_entry.is_empty() && vtree.is_released(mod_entry.v);
+        };
+        if (std::none_of(box.begin(), box.end(), is_released))
+        {
+            return;
+        }
+
+        std::vector<entry_t> kept;
+        kept.reserve(box.size());
+        for (auto& mod_entry : box)
+        {
+            if (mod_entry.is_empty())
+            {
+                continue;
+            }
+            if (!is_released(mod_entry))
+            {
+                kept.push_back(mod_entry);
+                continue;
+            }
+            for (auto& heir : vtree.get_heirs(mod_entry.v))
+            {
+                bool shadowed = false;
+                for (auto& other : box)
+                {
+                    if (&other != &mod_entry && !other.is_empty() && other.field() == mod_entry.field() &&
+                        mod_entry.v < other.v && other.v <= heir)
+                    {
+                        shadowed = true;
+                        break;
+                    }
+                }
+                if (!shadowed)
+                {
+                    kept.push_back(mod_entry);
+                    kept.back().v = heir;
+                }
+            }
+        }
+        kept.resize(std::max(box.size(), kept.size()));
+        box.assign(kept.begin(), kept.end());
+    }
+
+    //removes versions released in vtree for node based structures:
+    //marks every node of pool reachable from live versions (and extra roots)
+    //collapsing mod entries of released versions on the way, then frees the
+    //nodes which are left unmarked, links are plain ids so no cycle keeps them.
+    //returns an estimate of bytes used by the nodes and versions which are left
+    template <class node_t>
+    size_t collect_nodes(version_tree<node_handle<node_t>>& vtree, node_pool<node_t>& pool,
+                         std::vector<node_handle<node_t>> roots = std::vector<node_handle<node_t>>())
+    {
+        typedef typename node_handle<node_t> node_ptr_t;
+        typename version_tree<node_ptr_t>::write_guard guard(vtree);
+        std::vector<bool> visited(pool.id_bound());
+        std::vector<node_id> stack;
+        size_t bytes = 0;
+
+        vtree.begin_collection();
+        vtree.for_each_live_value([&](const node_ptr_t& root)
+        {
+            roots.push_back(root);
+        });
+        for (auto& root : roots)
+        {
+            stack.push_back(root.get_id());
+        }
+        while (!stack.empty())
+        {
+            node_id id = stack.back();
+            stack.pop_back();
+            if (id == no_node || visited[id])
+            {
+                continue;
+            }
+            visited[id] = true;
+            auto& node = pool[id];
+            node.prune_mods(vtree);
+            bytes += node.memory_usage();
+            node.for_each_link([&](node_id link)
+            {
+                if (link != no_node && !visited[link])
+                {
+                    stack.push_back(link);
+                }
+            });
+        }
+
+        vtree.end_collection([](const node_ptr_t&)
+        {
+        });
+        pool.for_each_live([&](node_id id)
+        {
+            if (!visited[id])
+            {
+                pool.destroy(id);
+            }
+        });
+        return bytes + vtree.memory_usage();
+    }
+
+    //nodes of a pool and the entries in their mod boxes, garbage included
+    struct node_stats
+    {
+        size_t nodes;
+        size_t mod_entries;
+    };
+
+    template <class node_t>
+    node_stats count_nodes(node_pool<node_t>& pool)
+    {
+        node_stats stats = { pool.size(), 0 };
+        pool.for_each_live([&](node_id id)
+        {
+            pool[id].mod_box.for_each([&](typename node_t::mod_box_entry&)
+            {
+                stats.mod_entries++;
+            });
+        });
+        return stats;
+    }
+}
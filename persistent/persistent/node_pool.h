@@ -0,0 +1,229 @@
+#pragma once
+#include <new>
+#include <array>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <type_traits>
+#include "version/rw_spin_lock.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace persistent
+{
+    typedef uint32_t node_id;
+    static const node_id no_node = UINT32_MAX;
+
+    inline size_t highest_bit(uint32_t x)
+    {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanReverse(&bit, x);
+        return (size_t)bit;
+#else
+        return (size_t)(31 - __builtin_clz(x));
+#endif
+    }
+
+    template <class node_t>
+    class node_pool;
+
+    //node of a node_pool: the pool and the node's id. copying one touches
+    //no reference count, nodes only keep the id of the nodes they link to
+    template <class node_t>
+    class node_handle
+    {
+        node_pool<node_t>* pool;
+        node_id id;
+
+    public:
+        node_handle() :
+            pool(nullptr),
+            id(no_node)
+        {
+        }
+
+        node_handle(node_pool<node_t>* pool, node_id id) :
+            pool(pool),
+            id(id)
+        {
+        }
+
+        node_id get_id() const
+        {
+            return id;
+        }
+
+        node_pool<node_t>* get_pool() const
+        {
+            return pool;
+        }
+
+        //a node of the same pool, or null for no_node
+        node_handle at(node_id other) const
+        {
+            return node_handle(other == no_node ? nullptr : pool, other);
+        }
+
+        node_t* get() const
+        {
+            return id == no_node ? nullptr : &(*pool)[id];
+        }
+
+        node_t* operator->() const
+        {
+            return &(*pool)[id];
+        }
+
+        node_t& operator*() const
+        {
+            return (*pool)[id];
+        }
+
+        explicit operator bool() const
+        {
+            return id != no_node;
+        }
+
+        bool operator==(const node_handle& other) const
+        {
+            return id == other.id;
+        }
+
+        bool operator!=(const node_handle& other) const
+        {
+            return id != other.id;
+        }
+    };
+
+    //nodes of the structures sharing a version tree, addressed by 32-bit ids.
+    //chunk k holds first_chunk_size << k nodes and never moves, so the chunk
+    //table has a fixed size and readers index it while writers on other
+    //branches allocate. nodes are freed by collect_nodes or with the pool
+    template <class node_t>
+    class node_pool
+    {
+        static const size_t first_chunk_bits = 4;
+        static const size_t first_chunk_size = (size_t)1 << first_chunk_bits;
+        static const size_t max_chunks = 32 - first_chunk_bits;
+
+        typedef typename std::aligned_storage<sizeof(node_t), std::alignment_of<node_t>::value>::type slot_t;
+
+        std::array<slot_t*, max_chunks> chunks;
+        size_t chunk_count;
+        //ids handed out so far, freed ones included
+        size_t id_count;
+        std::vector<node_id> free_ids;
+        std::vector<bool> live;
+        //guards allocation, freeing happens under the version tree's write_guard
+        spin_lock lock;
+
+        static size_t chunk_of(node_id id)
+        {
+            return highest_bit(id + first_chunk_size) - first_chunk_bits;
+        }
+
+        slot_t& slot(node_id id) const
+        {
+            size_t chunk = chunk_of(id);
+            return chunks[chunk][id + first_chunk_size - (first_chunk_size << chunk)];
+        }
+
+        node_id allocate()
+        {
+            std::lock_guard<spin_lock> guard(lock);
+            node_id id;
+            if (!free_ids.empty())
+            {
+                id = free_ids.back();
+                free_ids.pop_back();
+            }
+            else
+            {
+                assert(id_count < no_node);
+                id = (node_id)id_count++;
+                if (chunk_of(id) == chunk_count)
+                {
+                    chunks[chunk_count] = new slot_t[first_chunk_size << chunk_count];
+                    chunk_count++;
+                }
+                live.push_back(false);
+            }
+            live[id] = true;
+            return id;
+        }
+
+    public:
+        node_pool() :
+            chunk_count(0),
+            id_count(0)
+        {
+            chunks.fill(nullptr);
+        }
+
+        node_pool(const node_pool&) = delete;
+        node_pool& operator=(const node_pool&) = delete;
+
+        ~node_pool()
+        {
+            for_each_live([&](node_id id)
+            {
+                (*this)[id].~node_t();
+            });
+            for (size_t i = 0; i < chunk_count; i++)
+            {
+                delete[] chunks[i];
+            }
+        }
+
+        //constructs node_t(handle of the new node, args...)
+        template <class... Args>
+        node_handle<node_t> create(Args&&... args)
+        {
+            node_id id = allocate();
+            node_handle<node_t> node(this, id);
+            new (&slot(id)) node_t(node, std::forward<Args>(args)...);
+            return node;
+        }
+
+        void destroy(node_id id)
+        {
+            assert(live[id]);
+            (*this)[id].~node_t();
+            live[id] = false;
+            free_ids.push_back(id);
+        }
+
+        node_t& operator[](node_id id) const
+        {
+            return *reinterpret_cast<node_t*>(&slot(id));
+        }
+
+        //ids are below id_bound()
+        size_t id_bound() const
+        {
+            return id_count;
+        }
+
+        size_t size() const
+        {
+            return id_count - free_ids.size();
+        }
+
+        template <class F>
+        void for_each_live(F f)
+        {
+            for (size_t id = 0; id < id_count; id++)
+            {
+                if (live[id])
+                {
+                    f((node_id)id);
+                }
+            }
+        }
+    };
+}
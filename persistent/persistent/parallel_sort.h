@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+namespace persistent
+{
+    //below this many items one thread sorts faster than several start
+    static const size_t min_parallel_sort = 1 << 14;
+
+    //stable sort of items on threads, every hardware thread by default: runs are sorted
+    //side by side, then neighbouring runs are merged pairwise, also side by side
+    template <class T, class less_t>
+    void parallel_stable_sort(std::vector<T>& items, less_t less, size_t threads = std::thread::hardware_concurrency())
+    {
+        if (threads <= 1 || items.size() < min_parallel_sort)
+        {
+            std::stable_sort(items.begin(), items.end(), less);
+            return;
+        }
+
+        //run i is [bounds[i], bounds[i + 1])
+        std::vector<size_t> bounds;
+        for (size_t i = 0; i < threads; i++)
+        {
+            bounds.push_back(items.size() * i / threads);
+        }
+        bounds.push_back(items.size());
+        auto at = [&](size_t bound)
+        {
+            return items.begin() + bounds[std::min(bound, threads)];
+        };
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++)
+        {
+            workers.push_back(std::thread([&, i]()
+            {
+                std::stable_sort(at(i), at(i + 1), less);
+            }));
+        }
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for (size_t width = 1; width < threads; width *= 2)
+        {
+            workers.clear();
+            for (size_t i = 0; i + width < threads; i += 2 * width)
+            {
+                workers.push_back(std::thread([&, i, width]()
+                {
+                    std::inplace_merge(at(i), at(i + width), at(i + 2 * width), less);
+                }));
+            }
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+        }
+    }
+}
@@ -0,0 +1,318 @@
+#pragma once
+#include <mutex>
+#include <tuple>
+#include <type_traits>
+#include "version/version_tree.h"
+#include "version/version_context.h"
+#include "version/rw_spin_lock.h"
+#include "persistent/persistent_structure.h"
+#include "persistent/node_pool.h"
+#include "persistent/mod_entry.h"
+#include "persistent/bounded_mod_box.h"
+#include "persistent/fat_mod_box.h"
+
+namespace persistent
+{
+    //type of a field which links to another node of the same pool
+    struct node_link
+    {
+    };
+
+    template <class field_type>
+    struct node_field_traits
+    {
+        //held in the node and in its mod entries
+        typedef field_type stored_type;
+        static const bool is_link = false;
+    };
+
+    template <>
+    struct node_field_traits<node_link>
+    {
+        typedef node_id stored_type;
+        static const bool is_link = true;
+    };
+
+    //node of a persistent structure with versioned fields of the given types,
+    //addressed by index: a value type or node_link. a write in a version goes
+    //to the mod box, a full box copies the node as the version sees it, so the
+    //structure has to relink its neighbours. node_t derives from it and provides
+    //  node_t(const node_ptr_t& self, node_t& from, const version_context_t& vc),
+    //      the copy of from as vc.v sees it, which calls the engine's copy constructor
+    //  void replace_with(const node_ptr_t& new_node, const version_context_t& vc),
+    //      which points the neighbours new_node sees in vc.v at it instead of self
+    template <class node_t, bool fat_node, size_t mod_box_size, class... fields>
+    struct persistent_node
+    {
+        typedef typename node_handle<node_t> node_ptr_t;
+        typedef typename node_pool<node_t> node_pool_t;
+        typedef typename version_tree<node_ptr_t> version_tree_t;
+        typedef typename version_context<node_ptr_t> version_context_t;
+        typedef typename mod_entry<typename node_field_traits<fields>::stored_type...> mod_box_entry;
+        static const size_t field_count = sizeof...(fields);
+        //fat nodes keep every entry, the others split when their box is full
+        typedef typename std::conditional<fat_node,
+            fat_mod_box<mod_box_entry, field_count>,
+            bounded_mod_box<mod_box_entry, field_count, mod_box_size>>::type mod_box_t;
+
+        template <size_t field>
+        struct field_info
+        {
+            typedef typename std::tuple_element<field, std::tuple<fields...>>::type declared_type;
+            typedef typename node_field_traits<declared_type>::stored_type stored_type;
+            static const bool is_link = node_field_traits<declared_type>::is_link;
+            //get() returns a node of the pool for links and a reference to the value otherwise
+            typedef typename std::conditional<is_link, node_ptr_t, stored_type&>::type result_type;
+            typedef typename std::conditional<is_link, node_ptr_t, stored_type>::type param_type;
+        };
+
+        //this node in its pool, links are ids in the same pool
+        const node_ptr_t self;
+        //fields as the node was created, entries of mod_box override them
+        std::tuple<typename node_field_traits<fields>::stored_type...> base;
+        mod_box_t mod_box;
+        //guards mod_box, writers on different branches can share a node
+        mutable spin_lock mod_lock;
+
+        explicit persistent_node(const node_ptr_t& self) :
+            self(self)
+        {
+        }
+
+        //a copy of from as vc.v sees it, with an empty box
+        persistent_node(const node_ptr_t& self, node_t& from, const version_context_t& vc) :
+            self(self)
+        {
+            copy_fields(from, vc, std::integral_constant<size_t, 0>());
+            register_fields(vc);
+        }
+
+        //sets a field of a node which is being created
+        template <size_t field>
+        void init(const typename field_info<field>::param_type& value)
+        {
+            std::get<field>(base) = stored(value);
+        }
+
+        //lets persistent structures held in value fields report their changes,
+        //node_t calls it once its fields are set
+        void register_fields(const version_context_t& vc)
+        {
+            register_fields(vc, std::integral_constant<size_t, 0>());
+        }
+
+        //the field as version vc.v sees it
+        template <size_t field>
+        typename field_info<field>::stored_type& find_field(const version_context_t& vc)
+        {
+            mod_box_entry* m;
+            {
+                std::lock_guard<spin_lock> guard(mod_lock);
+                m = mod_box.find(field, vc.v);
+            }
+            return !m ? std::get<field>(base) : m->template get<field>();
+        }
+
+        template <size_t field>
+        typename field_info<field>::result_type get_field(const version_context_t& vc)
+        {
+            return load_field<field>(vc, std::integral_constant<bool, field_info<field>::is_link>());
+        }
+
+        //returns the node which holds the field in vc.v from now on,
+        //a copy of this one when its box was full
+        template <size_t field>
+        node_ptr_t set_field(const typename field_info<field>::param_type& new_value, const version_context_t& vc)
+        {
+            auto node = write_field<field>(new_value, vc);
+            if (node != self)
+            {
+                static_cast<node_t*>(this)->replace_with(node, vc);
+            }
+            return node;
+        }
+
+        //set_field which leaves linking a copy in place of this node to the caller,
+        //for structures which keep the path to the node while they rearrange it
+        template <size_t field>
+        node_ptr_t write_field(const typename field_info<field>::param_type& new_value, const version_context_t& vc)
+        {
+            auto node = self;
+            if (!try_add_mod<field>(vc.v, stored(new_value)))
+            {
+                node = split(vc);
+                std::get<field>(node->base) = stored(new_value);
+            }
+            after_set<field>(node, vc, std::integral_constant<bool, field_info<field>::is_link>());
+            return node;
+        }
+
+        //adds the entry of a field written in version v, a field written again
+        //in the same version overwrites its entry. false when the box is full
+        template <size_t field>
+        bool try_add_mod(version v, const typename field_info<field>::stored_type& new_value)
+        {
+            std::lock_guard<spin_lock> guard(mod_lock);
+            return mod_box.try_add(mod_box_entry::template make<field>(v, new_value));
+        }
+
+        //callers hold mod_lock or own the node
+        bool is_mod_box_full() const
+        {
+            return mod_box.is_full();
+        }
+
+        //a copy of the node as version vc.v sees it, with an empty box. it takes
+        //this node's place in vc.v and its descendants only, older versions keep
+        //reading this one, so entries are copied, not moved
+        node_ptr_t split(const version_context_t& vc)
+        {
+            return self.get_pool()->create(static_cast<node_t&>(*this), vc);
+        }
+
+        //moves or drops mod entries of versions released in vtree
+        void prune_mods(const version_tree_t& vtree)
+        {
+            mod_box.prune(vtree);
+        }
+
+        size_t memory_usage() const
+        {
+            return sizeof(node_t) + mod_box.heap_usage();
+        }
+
+        //f gets the id of every node this one links to in any version, no_node included
+        template <class F>
+        void for_each_link(F f)
+        {
+            for_each_base_link(f, std::integral_constant<size_t, 0>());
+            mod_box.for_each([&](mod_box_entry& mod_entry)
+            {
+                if (is_link_field(mod_entry.field()))
+                {
+                    f(*static_cast<node_id*>(mod_entry.data()));
+                }
+            });
+        }
+
+        static bool is_link_field(size_t field)
+        {
+            static const bool links[] = { node_field_traits<fields>::is_link... };
+            return links[field];
+        }
+
+    private:
+        static node_id stored(const node_ptr_t& node)
+        {
+            return node.get_id();
+        }
+
+        template <class T>
+        static const T& stored(const T& value)
+        {
+            return value;
+        }
+
+        template <size_t field>
+        node_ptr_t load_field(const version_context_t& vc, std::true_type)
+        {
+            return self.at(find_field<field>(vc));
+        }
+
+        template <size_t field>
+        typename field_info<field>::stored_type& load_field(const version_context_t& vc, std::false_type)
+        {
+            auto& val = find_field<field>(vc);
+            register_callbacks<field, typename field_info<field>::stored_type>(val, vc);
+            return val;
+        }
+
+        template <size_t field>
+        void after_set(const node_ptr_t& node, const version_context_t& vc, std::true_type)
+        {
+        }
+
+        template <size_t field>
+        void after_set(const node_ptr_t& node, const version_context_t& vc, std::false_type)
+        {
+            node->template get_field<field>(vc);
+        }
+
+        void copy_fields(node_t& from, const version_context_t& vc, std::integral_constant<size_t, field_count>)
+        {
+        }
+
+        template <size_t field>
+        void copy_fields(node_t& from, const version_context_t& vc, std::integral_constant<size_t, field>)
+        {
+            std::get<field>(base) = from.template find_field<field>(vc);
+            copy_fields(from, vc, std::integral_constant<size_t, field + 1>());
+        }
+
+        void register_fields(const version_context_t& vc, std::integral_constant<size_t, field_count>)
+        {
+        }
+
+        template <size_t field>
+        void register_fields(const version_context_t& vc, std::integral_constant<size_t, field>)
+        {
+            register_field<field>(vc, std::integral_constant<bool, field_info<field>::is_link>());
+            register_fields(vc, std::integral_constant<size_t, field + 1>());
+        }
+
+        template <size_t field>
+        void register_field(const version_context_t& vc, std::true_type)
+        {
+        }
+
+        template <size_t field>
+        void register_field(const version_context_t& vc, std::false_type)
+        {
+            register_callbacks<field, typename field_info<field>::stored_type>(std::get<field>(base), vc);
+        }
+
+        //use SFINAE to find out whether or not T is persistent structure
+        template <size_t field, class T>
+        void register_callbacks(typename T::persistent_type& val, const version_context_t& vc)
+        {
+            auto& pds = (persistent_structure<T>&)val;
+            pds.set_parent_version(vc.v);
+            pds.add_parent(vc.vs,
+                [&, vc](version node_version, const T& new_value)
+                {
+                    //a change made during an edit of the parent goes to the edit version
+                    auto new_version = vc.vs->is_edit_version(vc.v) ? vc.v : vc.vtree->insert(vc.v, vc.vtree->get_value(vc.v));
+                    set_field<field>(new_value, version_context_t(vc.vs, new_version, vc.vtree));
+                    return new_version;
+                });
+        }
+
+        template <size_t field, class T>
+        void register_callbacks(T& val, const version_context_t& vc)
+        {
+        }
+
+        template <class F>
+        void for_each_base_link(F& f, std::integral_constant<size_t, field_count>)
+        {
+        }
+
+        template <class F, size_t field>
+        void for_each_base_link(F& f, std::integral_constant<size_t, field>)
+        {
+            visit_link(f, std::get<field>(base), std::integral_constant<bool, field_info<field>::is_link>());
+            for_each_base_link(f, std::integral_constant<size_t, field + 1>());
+        }
+
+        template <class F>
+        static void visit_link(F& f, node_id id, std::true_type)
+        {
+            f(id);
+        }
+
+        template <class F, class T>
+        static void visit_link(F& f, const T& value, std::false_type)
+        {
+        }
+    };
+}
@@ -1,6 +1,9 @@
 #pragma once
 #include "version.h"
+#include "retention_policy.h"
 #include <functional>
+#include <deque>
+#include <unordered_set>
 #include <cassert>
 
 namespace persistent
@@ -12,8 +15,86 @@ namespace persistent
         version parent_version;
         version_structure* parent;
         version_history history;
+        retention_policy retention;
+        //versions of this structure in the order they appeared, for retention,
+        //each with its place among every version tracked so far
+        struct timeline_entry
+        {
+            version v;
+            size_t sequence;
+        };
+
+        std::deque<timeline_entry> timeline;
+        size_t next_sequence;
+        std::unordered_set<version_id> in_timeline;
+        std::vector<version> tags;
+        size_t next_prune;
+
+        bool is_tagged(const version& v) const
+        {
+            for (auto& tag : tags)
+            {
+                if (tag == v)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void track_version(const version& v)
+        {
+            if (retention.is_keep_all() || !in_timeline.insert(v.get_id()).second)
+            {
+                return;
+            }
+            timeline_entry entry = { v, next_sequence++ };
+            timeline.push_back(entry);
+            if (timeline.size() >= next_prune)
+            {
+                prune_history();
+            }
+        }
+
+        //releases versions of the timeline which kept doesn't cover,
+        //returns false if there was nothing to release
+        bool release_versions(const std::vector<bool>& kept)
+        {
+            auto current = get_version();
+            std::unordered_set<version_id> pruned;
+            std::deque<timeline_entry> left;
+            for (size_t i = 0; i < timeline.size(); i++)
+            {
+                auto& v = timeline[i].v;
+                if (kept[i] || v == current || is_tagged(v))
+                {
+                    left.push_back(timeline[i]);
+                    continue;
+                }
+                release_version(v);
+                pruned.insert(v.get_id());
+                in_timeline.erase(v.get_id());
+            }
+            if (pruned.empty())
+            {
+                return false;
+            }
+            timeline.swap(left);
+            history.erase_if([&](const version& v)
+            {
+                return pruned.count(v.get_id()) != 0;
+            });
+            return true;
+        }
 
     public:
+        persistent_structure() :
+            parent(nullptr),
+            next_sequence(0),
+            next_prune(0)
+        {
+        }
+
         virtual void version_changed()
         {
             if (version_changed_callback)
@@ -26,6 +107,73 @@ namespace persistent
                 }
             }
             history.add_item(get_version());
+            track_version(get_version());
+        }
+
+        //edits made until the returned scope ends are applied under one new version
+        batch_scope batch()
+        {
+            return batch_scope(*this);
+        }
+
+        //history is pruned by the policy as the structure gets new versions,
+        //pruned versions must not be used anymore
+        void set_retention_policy(const retention_policy& policy)
+        {
+            retention = policy;
+            next_prune = 0;
+        }
+
+        //a tagged version is never pruned by the retention policy
+        void tag_version(version v)
+        {
+            if (!is_tagged(v))
+            {
+                tags.push_back(v);
+            }
+        }
+
+        void untag_version(version v)
+        {
+            tags.erase(std::remove(tags.begin(), tags.end(), v), tags.end());
+        }
+
+        //applies the retention policy right away, and then drops the older half of what
+        //is left until the structure fits its memory budget; returns the estimated bytes
+        size_t prune_history()
+        {
+            //ages count the versions pruned before, or every prune would thin
+            //the survivors of the last one again
+            std::vector<size_t> ages;
+            for (auto& entry : timeline)
+            {
+                ages.push_back(next_sequence - 1 - entry.sequence);
+            }
+            release_versions(retention.select(ages));
+            auto bytes = collect_garbage();
+            while (retention.is_over_budget(bytes))
+            {
+                std::vector<bool> kept(timeline.size(), true);
+                std::fill(kept.begin(), kept.begin() + timeline.size() / 2, false);
+                if (!release_versions(kept))
+                {
+                    break;
+                }
+                bytes = collect_garbage();
+            }
+            next_prune = timeline.size() + retention.get_prune_interval();
+            return bytes;
+        }
+
+        //versions the retention policy has tracked and not pruned, oldest first
+        std::vector<version> get_retained_versions() const
+        {
+            std::vector<version> retained;
+            for (auto& entry : timeline)
+            {
+                retained.push_back(entry.v);
+            }
+            return retained;
         }
 
         void undo()
@@ -66,7 +214,11 @@ namespace persistent
             return parent_version;
         }
 
-        virtual void switch_new_version() = 0;
         virtual T create_with_version(version v) = 0;
+        //v won't be used anymore, it is removed by the next collect_garbage()
+        //and its changes are moved into its descendants which are still alive
+        virtual void release_version(version v) = 0;
+        //returns an estimate of bytes the structure takes after collection
+        virtual size_t collect_garbage() = 0;
     };
 }
@@ -0,0 +1,133 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+namespace persistent
+{
+    //decides which versions of a structure history survive pruning.
+    //a history is the list of versions in the order they appeared, the newest
+    //has age 0; tagged versions and the current one are kept by the structure
+    class retention_policy
+    {
+    public:
+        enum class kind
+        {
+            keep_all,
+            keep_last,
+            geometric
+        };
+
+        //structures prune at most once per this many new versions
+        static const size_t min_prune_interval = 16;
+
+    private:
+        kind policy_kind;
+        size_t count;
+        size_t memory_budget;
+
+        retention_policy(kind policy_kind, size_t count) :
+            policy_kind(policy_kind),
+            count(count),
+            memory_budget(0)
+        {
+        }
+
+    public:
+        retention_policy() :
+            retention_policy(kind::keep_all, 0)
+        {
+        }
+
+        static retention_policy keep_all()
+        {
+            return retention_policy(kind::keep_all, 0);
+        }
+
+        //keeps the n newest versions
+        static retention_policy keep_last(size_t n)
+        {
+            return retention_policy(kind::keep_last, n);
+        }
+
+        //keeps the `recent` newest versions and one version for every age range
+        //[recent + 2^k - 1, recent + 2^(k+1) - 1), so old history gets exponentially sparser
+        static retention_policy geometric(size_t recent)
+        {
+            return retention_policy(kind::geometric, recent);
+        }
+
+        //on top of the policy, old versions are pruned while the structure
+        //takes more than bytes (as estimated by collect_garbage())
+        retention_policy& with_memory_budget(size_t bytes)
+        {
+            memory_budget = bytes;
+            return *this;
+        }
+
+        bool is_keep_all() const
+        {
+            return policy_kind == kind::keep_all && memory_budget == 0;
+        }
+
+        bool is_over_budget(size_t bytes) const
+        {
+            return memory_budget != 0 && bytes > memory_budget;
+        }
+
+        size_t get_prune_interval() const
+        {
+            return count > min_prune_interval ? count : min_prune_interval;
+        }
+
+        //kept[i] says whether the i-th oldest of n versions is kept, the versions
+        //being the n newest ones of their structure
+        std::vector<bool> select(size_t n) const
+        {
+            std::vector<size_t> ages;
+            for (size_t i = 0; i < n; i++)
+            {
+                ages.push_back(n - 1 - i);
+            }
+            return select(ages);
+        }
+
+        //kept[i] says whether the i-th oldest version is kept, ages[i] is how many
+        //versions appeared after it, pruned ones included, so a version's age
+        //doesn't shrink as the ones around it are pruned
+        std::vector<bool> select(const std::vector<size_t>& ages) const
+        {
+            size_t n = ages.size();
+            std::vector<bool> kept(n, true);
+            switch (policy_kind)
+            {
+            case kind::keep_all:
+                break;
+            case kind::keep_last:
+                for (size_t i = 0; i + count < n; i++)
+                {
+                    kept[i] = false;
+                }
+                break;
+            case kind::geometric:
+                {
+                    //going from the oldest, the first version of each range is kept
+                    size_t last_range = (size_t)-1;
+                    for (size_t i = 0; i < n && ages[i] >= count; i++)
+                    {
+                        size_t age = ages[i] - count;
+                        size_t range = 0;
+                        while (((age + 1) >> (range + 1)) != 0)
+                        {
+                            range++;
+                        }
+                        kept[i] = range != last_range;
+                        last_range = range;
+                    }
+                }
+                break;
+            }
+            return kept;
+        }
+    };
+}
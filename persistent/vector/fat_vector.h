@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include "linked_list/linked_list.h"
+#include "persistent/node_collector.h"
 
 namespace persistent
 {
@@ -9,10 +10,11 @@ namespace persistent
         public persistent_structure<fat_vector<value_type>>
     {
         typedef typename linked_list_node<value_type, true> node_t;
-        typedef typename std::shared_ptr<node_t> node_ptr_t;
+        typedef typename node_t::node_ptr_t node_ptr_t;
         typedef typename version_context<node_ptr_t> version_context_t;
 
         std::shared_ptr<version_tree<node_ptr_t>> vtree;
+        std::shared_ptr<node_pool<node_t>> pool;
         std::vector<node_ptr_t> vec;
         version current_version;
 
@@ -96,20 +98,23 @@ namespace persistent
             }
         };
 
-        fat_vector() :
-            vtree(new version_tree<node_ptr_t>),
+        fat_vector(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<node_ptr_t>(node_ptr_t(), mode)),
+            pool(new node_pool<node_t>()),
             current_version(vtree->root_version())
         {
         }
 
         fat_vector(fat_vector& vec, version v) :
             vtree(vec.vtree),
+            pool(vec.pool),
             current_version(v)
         {
         }
 
         fat_vector(linked_list<value_type, true>& l) :
             vtree(l.vtree),
+            pool(l.pool),
             current_version(l.get_version())
         {
             vec.resize(l.size());
@@ -148,6 +153,17 @@ namespace persistent
             current_version = new_version;
         }
 
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            return collect_nodes(*vtree, *pool, vec);
+        }
+
         bool operator==(const fat_vector& v)
         {
             return vtree == v.vtree && current_version == v.current_version;
@@ -155,27 +171,35 @@ namespace persistent
 
         void resize(size_t new_size, value_type val = value_type())
         {
+            if (new_size == size())
+            {
+                return;
+            }
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             size_t old_size = vec.size();
             vec.resize(new_size);
             for (size_t i = old_size; i < new_size; i++)
             {
-                vec[i] = node_ptr_t(new node_t(val, get_vc(), node_ptr_t(), node_ptr_t()));
+                vec[i] = pool->create(val, get_vc());
             }
         }
 
         void update(int index, const value_type& val)
         {
+            if ((*this)[index] == val)
+            {
+                return;
+            }
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             vec[index]->set_value(val, get_vc());
         }
 
         iterator erase(iterator it)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
 
             int index = it.index;
             for (int i = index; i < size() - 1; i++)
@@ -189,8 +213,8 @@ namespace persistent
         void push_back(const value_type& val)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
-            vec.push_back(node_ptr_t(new node_t(val, get_vc(), node_ptr_t(), node_ptr_t())));
+            prepare_write();
+            vec.push_back(pool->create(val, get_vc()));
         }
 
         size_t size() const
@@ -90,8 +90,8 @@ namespace persistent
             }
         };
 
-        vector() :
-            vtree(new version_tree<vector_ptr_t>),
+        vector(persistence_mode mode = persistence_mode::full) :
+            vtree(new version_tree<vector_ptr_t>(vector_ptr_t(), mode)),
             current_version(vtree->root_version())
         {
             vtree->update(vtree->root_version(), vector_ptr_t(new std::vector<value_type>()));
@@ -136,6 +136,28 @@ namespace persistent
             current_version = new_version;
         }
 
+        void release_version(version v) override
+        {
+            assert(v != current_version);
+            vtree->release(v);
+        }
+
+        size_t collect_garbage() override
+        {
+            //every version owns its own copy, so there are no shared nodes to prune
+            typename version_tree<vector_ptr_t>::write_guard guard(*vtree);
+            vtree->begin_collection();
+            vtree->end_collection([](const vector_ptr_t&)
+            {
+            });
+            size_t bytes = vtree->memory_usage();
+            vtree->for_each_live_value([&](const vector_ptr_t& vec)
+            {
+                bytes += sizeof(*vec) + vec->capacity() * sizeof(value_type);
+            });
+            return bytes;
+        }
+
         bool operator==(const vector& v)
         {
             return vtree == v.vtree && current_version == v.current_version;
@@ -143,16 +165,24 @@ namespace persistent
 
         void resize(size_t new_size, value_type val = value_type())
         {
+            if (new_size == size())
+            {
+                return;
+            }
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             auto& vec = get_std_vector();
             vec.resize(new_size, val);
         }
 
         void update(int index, const value_type& val)
         {
+            if (get_std_vector()[index] == val)
+            {
+                return;
+            }
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             auto& vec = get_std_vector();
             vec[index] = val;
         }
@@ -160,7 +190,7 @@ namespace persistent
         iterator erase(iterator it)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             auto& vec = get_std_vector();
             int index = it.index;
             vec.erase(ec.begin() + index);
@@ -170,7 +200,7 @@ namespace persistent
         void push_back(const value_type& val)
         {
             version_changed_notifier vcn(*this);
-            switch_new_version();
+            prepare_write();
             auto& v = get_std_vector();
             v.push_back(val);
         }
@@ -0,0 +1,42 @@
+#pragma once
+#include <climits>
+#include <string>
+
+//PERSISTENT_LABEL_BITS selects the width of version labels: 64 (default)
+//or 128 on compilers which provide unsigned __int128
+#ifndef PERSISTENT_LABEL_BITS
+#define PERSISTENT_LABEL_BITS 64
+#endif
+
+namespace persistent
+{
+#if PERSISTENT_LABEL_BITS == 128
+#ifndef __SIZEOF_INT128__
+#error "128-bit labels need unsigned __int128 support"
+#endif
+    typedef unsigned __int128 label_type;
+#elif PERSISTENT_LABEL_BITS == 64
+    typedef unsigned long long label_type;
+#else
+#error "PERSISTENT_LABEL_BITS should be 64 or 128"
+#endif
+
+    //numeric_limits is not specialized for 128-bit integers in strict modes
+    template <class label_t>
+    struct label_traits
+    {
+        static const int bits = (int)(sizeof(label_t) * CHAR_BIT);
+    };
+
+    template <class label_t>
+    std::string label_str(label_t label)
+    {
+        std::string s;
+        do
+        {
+            s.insert(s.begin(), (char)('0' + (int)(label % 10)));
+            label /= 10;
+        } while (label != 0);
+        return s;
+    }
+}
@@ -0,0 +1,352 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include "label.h"
+#include "slab.h"
+
+namespace persistent
+{
+    //two-level order maintenance list (Dietz-Sleator, Bender et al.)
+    //elements are kept in small groups and get local labels in the low bits,
+    //groups are labeled in the high bits, so an element label is a plain integer
+    //and an insertion relabels either one group or a local range of groups.
+    //elements are dense ids and their labels are kept in one contiguous table,
+    //groups live in a slab and are linked intrusively by ids
+    template <class label_t>
+    class order_list
+    {
+    public:
+        static const int label_bits = label_traits<label_t>::bits;
+        static const int local_bits = label_bits / 4;
+        static const int group_bits = label_bits - local_bits;
+        static const size_t max_group_size = local_bits * 2;
+
+        typedef uint32_t node_id;
+        typedef uint32_t group_id;
+
+        static const group_id no_group = UINT32_MAX;
+
+        struct stats
+        {
+            size_t relabel_count;
+            size_t max_relabel_size;
+            size_t group_count;
+        };
+
+    private:
+        struct group
+        {
+            label_t label;
+            size_t size;
+            group_id prev;
+            group_id next;
+            std::array<node_id, max_group_size> nodes;
+        };
+
+        slab<group> groups;
+        std::vector<group_id> free_groups;
+        size_t group_count;
+        group_id last_group;
+        std::vector<label_t> labels;
+        std::vector<group_id> owners;
+        size_t relabel_count;
+        size_t max_relabel_size;
+        size_t current_relabel_size;
+
+        static label_t local_range()
+        {
+            return (label_t)1 << local_bits;
+        }
+
+        static label_t group_range()
+        {
+            return (label_t)1 << group_bits;
+        }
+
+        label_t local_label(node_id n) const
+        {
+            return labels[n] & (local_range() - 1);
+        }
+
+        static label_t make_label(const group& g, label_t local)
+        {
+            return (g.label << local_bits) | local;
+        }
+
+        size_t index_of(node_id n) const
+        {
+            auto& g = groups[owners[n]];
+            auto it = std::lower_bound(g.nodes.begin(), g.nodes.begin() + g.size, n,
+                [this](node_id a, node_id b)
+                {
+                    return labels[a] < labels[b];
+                });
+            assert(*it == n);
+            return it - g.nodes.begin();
+        }
+
+        void relabel_group(group& g)
+        {
+            auto step = local_range() / (label_t)(g.size + 1);
+            assert(step >= 1);
+            for (size_t i = 0; i < g.size; i++)
+            {
+                labels[g.nodes[i]] = make_label(g, step * (label_t)(i + 1));
+            }
+            current_relabel_size += g.size;
+        }
+
+        void relabel_group_nodes(group& g)
+        {
+            for (size_t i = 0; i < g.size; i++)
+            {
+                labels[g.nodes[i]] = make_label(g, local_label(g.nodes[i]));
+            }
+            current_relabel_size += g.size;
+        }
+
+        //finds the smallest aligned range of group labels around g which is sparse
+        //enough and spreads its groups evenly leaving a free slot right after g
+        void relabel_range(group_id g)
+        {
+            auto first = g;
+            auto last = g;
+            size_t count = 1;
+            label_t g_label = groups[g].label;
+            for (int i = 1; i <= group_bits; i++)
+            {
+                label_t range = (label_t)1 << i;
+                label_t base = g_label & ~(range - 1);
+                while (groups[first].prev != no_group && groups[groups[first].prev].label >= base)
+                {
+                    first = groups[first].prev;
+                    count++;
+                }
+                while (groups[last].next != no_group && groups[groups[last].next].label - base < range)
+                {
+                    last = groups[last].next;
+                    count++;
+                }
+
+                //density threshold of a range of 2^i labels is T^-i, T is chosen
+                //so that the whole label space always fits twice the groups
+                double allowed = std::pow(2.0 * (group_count + 1), (double)i / group_bits);
+                if ((double)(count + 1) > allowed)
+                {
+                    continue;
+                }
+
+                auto step = range / (label_t)(count + 1);
+                label_t slot = 0;
+                for (auto it = first; ; it = groups[it].next)
+                {
+                    groups[it].label = base + step * slot;
+                    relabel_group_nodes(groups[it]);
+                    slot += (it == g) ? 2 : 1;
+                    if (it == last)
+                    {
+                        break;
+                    }
+                }
+                return;
+            }
+            assert(false && "order_list label space is exhausted");
+        }
+
+        group_id new_group(label_t label, group_id prev, group_id next)
+        {
+            group g;
+            g.label = label;
+            g.size = 0;
+            g.prev = prev;
+            g.next = next;
+            group_id id;
+            if (free_groups.empty())
+            {
+                id = groups.push_back(g);
+            }
+            else
+            {
+                id = free_groups.back();
+                free_groups.pop_back();
+                groups[id] = g;
+            }
+            group_count++;
+            if (prev != no_group)
+            {
+                groups[prev].next = id;
+            }
+            if (next != no_group)
+            {
+                groups[next].prev = id;
+            }
+            else
+            {
+                last_group = id;
+            }
+            return id;
+        }
+
+        void unlink_group(group_id g)
+        {
+            auto& gr = groups[g];
+            if (gr.prev != no_group)
+            {
+                groups[gr.prev].next = gr.next;
+            }
+            if (gr.next != no_group)
+            {
+                groups[gr.next].prev = gr.prev;
+            }
+            else
+            {
+                last_group = gr.prev;
+            }
+            free_groups.push_back(g);
+            group_count--;
+        }
+
+        group_id insert_group_after(group_id g)
+        {
+            auto next = groups[g].next;
+            label_t hi = next == no_group ? group_range() : groups[next].label;
+            if (hi - groups[g].label < 2)
+            {
+                relabel_range(g);
+                hi = next == no_group ? group_range() : groups[next].label;
+            }
+            label_t lo = groups[g].label;
+            assert(hi - lo >= 2);
+            return new_group(lo + (hi - lo) / 2, g, next);
+        }
+
+        void split_group(group_id g)
+        {
+            auto added = insert_group_after(g);
+            auto& old_group = groups[g];
+            auto& new_group = groups[added];
+            size_t half = old_group.size / 2;
+            for (size_t i = half; i < old_group.size; i++)
+            {
+                new_group.nodes[i - half] = old_group.nodes[i];
+                owners[old_group.nodes[i]] = added;
+            }
+            new_group.size = old_group.size - half;
+            old_group.size = half;
+            relabel_group(new_group);
+        }
+
+        void insert_into(group_id g, size_t index, node_id n)
+        {
+            if (n >= labels.size())
+            {
+                labels.resize(n + 1);
+                owners.resize(n + 1);
+            }
+            current_relabel_size = 0;
+            if (groups[g].size == max_group_size)
+            {
+                split_group(g);
+                if (index > groups[g].size)
+                {
+                    index -= groups[g].size;
+                    g = groups[g].next;
+                }
+            }
+
+            auto& gr = groups[g];
+            //local label 0 is never used, so 0 is free for erased elements
+            label_t lo = index > 0 ? local_label(gr.nodes[index - 1]) + 1 : 1;
+            label_t hi = index < gr.size ? local_label(gr.nodes[index]) : local_range();
+            for (size_t i = gr.size; i > index; i--)
+            {
+                gr.nodes[i] = gr.nodes[i - 1];
+            }
+            gr.nodes[index] = n;
+            gr.size++;
+            owners[n] = g;
+            if (lo < hi)
+            {
+                labels[n] = make_label(gr, lo + (hi - lo) / 2);
+            }
+            else
+            {
+                relabel_group(gr);
+            }
+
+            relabel_count += current_relabel_size;
+            max_relabel_size = std::max(max_relabel_size, current_relabel_size);
+        }
+
+    public:
+        order_list() :
+            group_count(0),
+            last_group(no_group),
+            relabel_count(0),
+            max_relabel_size(0),
+            current_relabel_size(0)
+        {
+        }
+
+        order_list(const order_list&) = delete;
+        order_list& operator=(const order_list&) = delete;
+
+        void push_back(node_id n)
+        {
+            if (last_group == no_group)
+            {
+                new_group(0, no_group, no_group);
+            }
+            insert_into(last_group, groups[last_group].size, n);
+        }
+
+        void insert_before(node_id where, node_id n)
+        {
+            insert_into(owners[where], index_of(where), n);
+        }
+
+        void insert_after(node_id where, node_id n)
+        {
+            insert_into(owners[where], index_of(where) + 1, n);
+        }
+
+        //removes n from the list, its label is reset to 0 which
+        //no element in the list has
+        void erase(node_id n)
+        {
+            auto g = owners[n];
+            auto& gr = groups[g];
+            for (size_t i = index_of(n) + 1; i < gr.size; i++)
+            {
+                gr.nodes[i - 1] = gr.nodes[i];
+            }
+            gr.size--;
+            labels[n] = 0;
+            owners[n] = no_group;
+            if (gr.size == 0)
+            {
+                unlink_group(g);
+            }
+        }
+
+        //labels stay valid (and the table stays at the same place) across relabeling
+        const std::vector<label_t>& get_labels() const
+        {
+            return labels;
+        }
+
+        stats get_stats() const
+        {
+            stats s;
+            s.relabel_count = relabel_count;
+            s.max_relabel_size = max_relabel_size;
+            s.group_count = group_count;
+            return s;
+        }
+    };
+}
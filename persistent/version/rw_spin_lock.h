@@ -0,0 +1,121 @@
+#pragma once
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+namespace persistent
+{
+    //readers-writer spin lock for short critical sections, a waiting writer
+    //keeps new readers out so relabeling doesn't starve
+    class rw_spin_lock
+    {
+        static const uint32_t writer_active = 1u << 31;
+        static const uint32_t writer_waiting = 1u << 30;
+
+        std::atomic<uint32_t> state;
+
+    public:
+        rw_spin_lock() :
+            state(0)
+        {
+        }
+
+        rw_spin_lock(const rw_spin_lock&) = delete;
+        rw_spin_lock& operator=(const rw_spin_lock&) = delete;
+
+        void lock_shared()
+        {
+            for (;;)
+            {
+                auto s = state.load(std::memory_order_relaxed);
+                if ((s & (writer_active | writer_waiting)) == 0 &&
+                    state.compare_exchange_weak(s, s + 1, std::memory_order_acquire))
+                {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock_shared()
+        {
+            state.fetch_sub(1, std::memory_order_release);
+        }
+
+        void lock()
+        {
+            for (;;)
+            {
+                auto s = state.load(std::memory_order_relaxed);
+                if ((s & ~writer_waiting) == 0 &&
+                    state.compare_exchange_weak(s, writer_active, std::memory_order_acquire))
+                {
+                    return;
+                }
+                state.fetch_or(writer_waiting, std::memory_order_relaxed);
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock()
+        {
+            state.fetch_and(~writer_active, std::memory_order_release);
+        }
+
+        //read holds the calling thread has on this lock, nested readers don't lock
+        //again (a waiting writer would deadlock them) and a writer thread which
+        //already reads gives its hold up while it writes
+        int& thread_read_depth()
+        {
+            thread_local std::vector<std::pair<const rw_spin_lock*, int>> depths;
+            for (auto& d : depths)
+            {
+                if (d.first == this)
+                {
+                    return d.second;
+                }
+            }
+            for (auto& d : depths)
+            {
+                if (d.second == 0)
+                {
+                    d.first = this;
+                    return d.second;
+                }
+            }
+            depths.push_back(std::make_pair(this, 0));
+            return depths.back().second;
+        }
+    };
+
+    //lock of a node's mod box, entries are only added or overwritten by the version
+    //which wrote them, so a found entry can be used after the lock is released
+    class spin_lock
+    {
+        std::atomic_flag flag;
+
+    public:
+        spin_lock()
+        {
+            flag.clear();
+        }
+
+        spin_lock(const spin_lock&) = delete;
+        spin_lock& operator=(const spin_lock&) = delete;
+
+        void lock()
+        {
+            while (flag.test_and_set(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        void unlock()
+        {
+            flag.clear(std::memory_order_release);
+        }
+    };
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+
+namespace persistent
+{
+    //chunked contiguous storage addressed by dense 32-bit ids,
+    //growing allocates one chunk at a time and never moves elements
+    template <class T, size_t chunk_bits = 10>
+    class slab
+    {
+        static const size_t chunk_size = (size_t)1 << chunk_bits;
+
+        std::vector<std::vector<T>> chunks;
+        size_t count;
+
+    public:
+        slab() :
+            count(0)
+        {
+        }
+
+        slab(const slab&) = delete;
+        slab& operator=(const slab&) = delete;
+
+        //UINT32_MAX is left to callers for "no element"
+        uint32_t push_back(const T& value)
+        {
+            if (count >= UINT32_MAX)
+            {
+                throw std::length_error("slab ids are 32-bit");
+            }
+            if (count == chunks.size() * chunk_size)
+            {
+                chunks.emplace_back();
+                chunks.back().reserve(chunk_size);
+            }
+            chunks.back().push_back(value);
+            return (uint32_t)count++;
+        }
+
+        T& operator[](uint32_t id)
+        {
+            return chunks[id >> chunk_bits][id & (chunk_size - 1)];
+        }
+
+        const T& operator[](uint32_t id) const
+        {
+            return chunks[id >> chunk_bits][id & (chunk_size - 1)];
+        }
+
+        size_t size() const
+        {
+            return count;
+        }
+    };
+}
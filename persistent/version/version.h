@@ -7,41 +7,81 @@
 #include <cassert>
 #include <sstream>
 #include <ostream>
+#include <cstdint>
+#include "label.h"
+#include "order_list.h"
 
 namespace persistent
 {
-    typedef unsigned label_type;
+    typedef order_list<label_type> order_list_t;
+    typedef uint32_t version_id;
 
-    class version_impl
+    //node ids of a version are 2 * id and 2 * id + 1, larger ids would wrap
+    static const version_id max_version_id = UINT32_MAX / 2;
+
+    //a version is an interval [begin, end] in the order list,
+    //descendant intervals are nested into ancestor ones
+    inline order_list_t::node_id begin_node(version_id id)
     {
-    public:
-        virtual label_type get_begin_label() const = 0;
-        virtual label_type get_end_label() const = 0;
-    };
+        return 2 * id;
+    }
 
+    inline order_list_t::node_id end_node(version_id id)
+    {
+        return 2 * id + 1;
+    }
+
+    //version handle is an id into the label table of its version tree,
+    //ancestry checks are two loads from that table with no virtual calls.
+    //labels of a removed version are (0, 0), so it is related to nothing
     class version
     {
-        version_impl* impl;
+        const std::vector<label_type>* labels;
+        version_id id;
 
     public:
-        version(version_impl* impl = nullptr) :
-            impl(impl)
+        version() :
+            labels(nullptr),
+            id(0)
+        {
+        }
+
+        version(const std::vector<label_type>* labels, version_id id) :
+            labels(labels),
+            id(id)
+        {
+        }
+
+        version_id get_id() const
         {
+            return id;
         }
 
-        version_impl* get_impl()
+        //labels of every version of the tree, indexed by begin_node()/end_node()
+        const label_type* get_label_table() const
         {
-            return impl;
+            return labels->data();
+        }
+
+        label_type get_begin_label() const
+        {
+            return (*labels)[begin_node(id)];
+        }
+
+        label_type get_end_label() const
+        {
+            return (*labels)[end_node(id)];
         }
 
         bool operator<(const version& v) const
         {
-            if (!impl || !v.impl)
+            if (!labels || !v.labels)
             {
                 return true;
             }
-            return impl->get_begin_label() < v.impl->get_begin_label() &&
-                   v.impl->get_end_label() < impl->get_end_label();
+            const label_type* l = labels->data();
+            return l[begin_node(id)] < l[begin_node(v.id)] &&
+                   l[end_node(v.id)] < l[end_node(id)];
         }
 
         bool operator<=(const version& v) const
@@ -51,13 +91,8 @@ namespace persistent
 
         bool operator==(const version& v) const
         {
-            assert(impl && v.impl);
-            if (!impl || !v.impl)
-            {
-                return impl == v.impl;
-            }
-            return impl->get_begin_label() == v.impl->get_begin_label() &&
-                   impl->get_end_label() == v.impl->get_end_label();;
+            assert(labels && v.labels);
+            return labels == v.labels && id == v.id;
         }
 
         bool operator!=(const version& v) const
@@ -65,69 +100,44 @@ namespace persistent
             return !operator==(v);
         }
 
-
         bool is_empty() const
         {
-            return !impl;
+            return !labels;
         }
 
         std::string str() const
         {
             std::ostringstream oss;
-            oss << "(" << impl->get_begin_label() << ", " << impl->get_end_label() << ")";
+            oss << "(" << label_str(get_begin_label()) << ", " << label_str(get_end_label()) << ")";
             return oss.str();
         }
     };
 
+    static const version_id no_version = UINT32_MAX;
+
     template <class value_type>
-    struct version_internal : public version_impl
+    struct version_internal
     {
-        typedef typename std::list<version_internal<value_type>> list_t;
-        typedef typename std::list<version_internal<value_type>>::iterator iterator_t;
-        static list_t default_version_list;
-
-        label_type begin_label;
-        label_type end_label;
-        label_type free_range;
         value_type value;
-        iterator_t list_iterator;
-
-        version_internal() :
-            list_iterator(default_version_list.begin())
-        {
-        }
-
-        version_internal(const label_type& begin_label,
-                         const label_type& end_label,
-                         const label_type& free_size,
-                         const value_type& value = value_type(),
-                         iterator_t list_iterator = iterator_t()) :
-            begin_label(begin_label),
-            end_label(end_label),
-            free_range(free_size),
+        version_id parent;
+        version_id first_child;
+        version_id next_sibling;
+        version_id prev_sibling;
+        //elements of the structure, for the ones which count them next to the root
+        uint32_t size;
+        bool released;
+
+        version_internal(const value_type& value = value_type(), version_id parent = 0, uint32_t size = 0) :
             value(value),
-            list_iterator(list_iterator)
-        {
-        }
-
-        operator version()
+            parent(parent),
+            first_child(no_version),
+            next_sibling(no_version),
+            prev_sibling(no_version),
+            size(size),
+            released(false)
         {
-            return version(this);
-        }
-
-        label_type get_begin_label() const
-        {
-            return begin_label;
-        }
-
-        label_type get_end_label() const
-        {
-            return end_label;
         }
     };
-
-    template <class value_type>
-    typename version_internal<value_type>::list_t version_internal<value_type>::default_version_list = { version_internal<value_type>() };
 }
 
 //std::ostream& operator<<(std::ostream& out, persistent::version v);
\ No newline at end of file
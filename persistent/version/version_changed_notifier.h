@@ -4,24 +4,40 @@
 
 namespace persistent
 {
+    //scope of an edit, nested scopes join the outermost one,
+    //which reports the change once if a version was made
     class version_changed_notifier
     {
-        version_structure& vs;
-        version v;
+        version_structure* vs;
 
     public:
         version_changed_notifier(version_structure& vs) :
-            vs(vs),
-            v(vs.get_version())
+            vs(&vs)
         {
+            if (vs.edit_depth++ == 0)
+            {
+                vs.edit_base = vs.get_version();
+            }
         }
 
+        version_changed_notifier(version_changed_notifier&& other) :
+            vs(other.vs)
+        {
+            other.vs = nullptr;
+        }
+
+        version_changed_notifier(const version_changed_notifier&) = delete;
+        version_changed_notifier& operator=(const version_changed_notifier&) = delete;
+
         ~version_changed_notifier()
         {
-            if (vs.get_version() != v)
+            if (vs && --vs->edit_depth == 0 && vs->get_version() != vs->edit_base)
             {
-                vs.version_changed();
+                vs->version_changed();
             }
         }
     };
-}
\ No newline at end of file
+
+    //all edits of a structure made while a batch is alive go to one version
+    typedef version_changed_notifier batch_scope;
+}
@@ -1,18 +1,19 @@
 #pragma once
 #include "version.h"
-#include <stack>
+#include <vector>
+#include <algorithm>
 
 namespace persistent
 {
     class version_history
     {
-        std::stack<version> undo_stack;
-        std::stack<version> redo_stack;
+        std::vector<version> undo_stack;
+        std::vector<version> redo_stack;
 
     public:
-        void add_item(version& v)
+        void add_item(const version& v)
         {
-            undo_stack.push(v);
+            undo_stack.push_back(v);
         }
 
         version pop_undo()
@@ -22,9 +23,9 @@ namespace persistent
                 return version();
             }
 
-            version v = undo_stack.top();
-            redo_stack.push(v);
-            undo_stack.pop();
+            version v = undo_stack.back();
+            redo_stack.push_back(v);
+            undo_stack.pop_back();
             return v;
         }
 
@@ -34,10 +35,18 @@ namespace persistent
             {
                 return version();
             }
-            version v = redo_stack.top();
-            undo_stack.push(v);
-            redo_stack.pop();
+            version v = redo_stack.back();
+            undo_stack.push_back(v);
+            redo_stack.pop_back();
             return v;
         }
+
+        //forgets pruned versions, undo and redo skip over them
+        template <class F>
+        void erase_if(F is_pruned)
+        {
+            undo_stack.erase(std::remove_if(undo_stack.begin(), undo_stack.end(), is_pruned), undo_stack.end());
+            redo_stack.erase(std::remove_if(redo_stack.begin(), redo_stack.end(), is_pruned), redo_stack.end());
+        }
     };
-}
\ No newline at end of file
+}
@@ -5,9 +5,37 @@ namespace persistent
 {
     class version_structure
     {
+        friend class version_changed_notifier;
+
+        //an edit is the outermost version_changed_notifier scope, it writes
+        //to one new version made on its first write
+        int edit_depth;
+        version edit_base;
+
     public:
+        version_structure() :
+            edit_depth(0)
+        {
+        }
+
         virtual version get_version() const = 0;
         virtual void set_version(const version& v) = 0;
         virtual void version_changed() = 0;
+        virtual void switch_new_version() = 0;
+
+        //v is a version the current edit made, so it can be written in place
+        bool is_edit_version(const version& v) const
+        {
+            return edit_depth > 0 && !edit_base.is_empty() && v != edit_base && v == get_version();
+        }
+
+        //to be called before every write, the first one of an edit makes its version
+        void prepare_write()
+        {
+            if (!is_edit_version(get_version()))
+            {
+                switch_new_version();
+            }
+        }
     };
 }
@@ -1,106 +1,395 @@
 #pragma once
-#include <list>
-#include <map>
+#include <vector>
 #include <utility>
+#include <unordered_map>
+#include <stdexcept>
 #include "version.h"
+#include "slab.h"
+#include "rw_spin_lock.h"
 
 namespace persistent
 {
+    //full persistence lets any version be changed (branched from), partial
+    //persistence only the newest one. versions of a partial tree are timestamps
+    //ts with labels (ts, max - ts), so ancestry is plain timestamp order and
+    //no order list is kept
+    enum class persistence_mode
+    {
+        full,
+        partial
+    };
+
     template <class value_type>
     class version_tree
     {
-        typedef typename std::list<version_internal<value_type>> list_t;
-        typedef typename std::list<version_internal<value_type>>::iterator iterator_t;
+        static const version_id root_id = 0;
+
+        persistence_mode mode;
+        std::vector<label_type> timestamps;
+        label_type next_timestamp;
+        version_id newest_id;
 
-        list_t version_list;
+        slab<version_internal<value_type>> versions;
+        order_list_t order;
+        //released versions stay in the tree until the next collection
+        std::vector<version_id> released_ids;
+        std::vector<version_id> free_ids;
+        //closest descendants of released versions which are not released themselves
+        std::unordered_map<version_id, std::vector<version>> heirs;
+        //labels and records are shared by readers, version creation (labels can be
+        //relabeled and tables can grow) and collection are exclusive
+        mutable rw_spin_lock lock;
 
-        void redistribute()
+        version make_version(version_id id) const
         {
-            auto sz = version_list.size();
-            auto min_value = std::numeric_limits<label_type>::min() + 1;
-            auto max_value = std::numeric_limits<label_type>::max();
-            auto step = (label_type)((max_value - min_value) / sz / 2);
-            assert(step > 1);
+            return version(is_partial() ? &timestamps : &order.get_labels(), id);
+        }
+
+        //a new version starts with the size of the one it is made from
+        version_id new_version_internal(const value_type& value, version_id parent)
+        {
+            uint32_t size = versions.size() > parent ? versions[parent].size : 0;
+            if (free_ids.empty())
+            {
+                if (versions.size() > max_version_id)
+                {
+                    throw std::length_error("too many live versions for 32-bit version ids");
+                }
+                return versions.push_back(version_internal<value_type>(value, parent, size));
+            }
+            auto id = free_ids.back();
+            free_ids.pop_back();
+            versions[id] = version_internal<value_type>(value, parent, size);
+            return id;
+        }
+
+        void link_child(version_id parent, version_id id)
+        {
+            auto& p = versions[parent];
+            auto& v = versions[id];
+            v.parent = parent;
+            v.prev_sibling = no_version;
+            v.next_sibling = p.first_child;
+            if (p.first_child != no_version)
+            {
+                versions[p.first_child].prev_sibling = id;
+            }
+            p.first_child = id;
+        }
 
-            std::map<label_type, version_internal<value_type>*> m;
-            for (auto& v : version_list)
+        void unlink_child(version_id id)
+        {
+            auto& v = versions[id];
+            if (v.prev_sibling != no_version)
+            {
+                versions[v.prev_sibling].next_sibling = v.next_sibling;
+            }
+            else
+            {
+                versions[v.parent].first_child = v.next_sibling;
+            }
+            if (v.next_sibling != no_version)
             {
-                m[v.begin_label] = &v;
-                m[v.end_label] = &v;
+                versions[v.next_sibling].prev_sibling = v.prev_sibling;
             }
+        }
 
-            label_type label = min_value;
-            for (auto& e : m)
+        //heirs of a released version are its live children plus the heirs of its
+        //released children, so released children are resolved first
+        void find_heirs(version_id top)
+        {
+            std::vector<version_id> stack(1, top);
+            while (!stack.empty())
             {
-                auto* v_int = e.second;
-                if (v_int->end_label != 0)
+                auto id = stack.back();
+                bool ready = true;
+                for (auto c = versions[id].first_child; c != no_version; c = versions[c].next_sibling)
+                {
+                    if (versions[c].released && !heirs.count(c))
+                    {
+                        stack.push_back(c);
+                        ready = false;
+                    }
+                }
+                if (!ready)
                 {
-                    v_int->begin_label = label;
-                    v_int->end_label = 0;
+                    continue;
                 }
-                else
+                stack.pop_back();
+                auto& found = heirs[id];
+                for (auto c = versions[id].first_child; c != no_version; c = versions[c].next_sibling)
                 {
-                    v_int->end_label = label;
-                    v_int->free_range = step - 1;
+                    if (versions[c].released)
+                    {
+                        auto& below = heirs[c];
+                        found.insert(found.end(), below.begin(), below.end());
+                    }
+                    else
+                    {
+                        found.push_back(make_version(c));
+                    }
                 }
-                label += step;
             }
         }
 
+        //children of a removed version become children of its parent, their
+        //intervals are already nested into the parent one
+        void splice_out(version_id id)
+        {
+            auto parent = versions[id].parent;
+            unlink_child(id);
+            auto c = versions[id].first_child;
+            while (c != no_version)
+            {
+                auto next = versions[c].next_sibling;
+                link_child(parent, c);
+                c = next;
+            }
+            versions[id].first_child = no_version;
+            if (is_partial())
+            {
+                timestamps[begin_node(id)] = 0;
+                timestamps[end_node(id)] = 0;
+                return;
+            }
+            order.erase(begin_node(id));
+            order.erase(end_node(id));
+        }
+
+        void push_timestamp(version_id id)
+        {
+            if (timestamps.size() <= end_node(id))
+            {
+                timestamps.resize(end_node(id) + 1);
+            }
+            timestamps[begin_node(id)] = next_timestamp;
+            timestamps[end_node(id)] = ~(label_type)0 - next_timestamp;
+            next_timestamp++;
+        }
+
     public:
-        version_tree(const value_type& root_value = value_type())
+        //held while nodes of the tree are read, so several threads can work
+        //on different branches at once; guards of one thread nest
+        class read_guard
         {
-            auto min_value = std::numeric_limits<label_type>::min();
-            auto max_value = std::numeric_limits<label_type>::max();
-            assert(min_value == 0);
-            //reserve 0 value jic
-            auto free_range = max_value - min_value - 2;
-            version_list.push_back(version_internal<value_type>(min_value + 1, max_value, free_range, root_value));
-            version_list.begin()->list_iterator = version_list.begin();
+            rw_spin_lock& lock;
+
+        public:
+            read_guard(const version_tree& tree) :
+                lock(tree.lock)
+            {
+                if (lock.thread_read_depth()++ == 0)
+                {
+                    lock.lock_shared();
+                }
+            }
+
+            read_guard(const read_guard&) = delete;
+            read_guard& operator=(const read_guard&) = delete;
+
+            ~read_guard()
+            {
+                if (--lock.thread_read_depth() == 0)
+                {
+                    lock.unlock_shared();
+                }
+            }
+        };
+
+        //exclusive access, a read hold of the calling thread is given up meanwhile
+        class write_guard
+        {
+            rw_spin_lock& lock;
+            bool reading;
+
+        public:
+            write_guard(const version_tree& tree) :
+                lock(tree.lock),
+                reading(lock.thread_read_depth() > 0)
+            {
+                if (reading)
+                {
+                    lock.unlock_shared();
+                }
+                lock.lock();
+            }
+
+            write_guard(const write_guard&) = delete;
+            write_guard& operator=(const write_guard&) = delete;
+
+            ~write_guard()
+            {
+                lock.unlock();
+                if (reading)
+                {
+                    lock.lock_shared();
+                }
+            }
+        };
+
+        version_tree(const value_type& root_value = value_type(), persistence_mode mode = persistence_mode::full) :
+            mode(mode),
+            next_timestamp(1),
+            newest_id(root_id)
+        {
+            auto root = new_version_internal(root_value, root_id);
+            if (is_partial())
+            {
+                push_timestamp(root);
+                return;
+            }
+            order.push_back(begin_node(root));
+            order.push_back(end_node(root));
         }
 
+        version_tree(const version_tree&) = delete;
+        version_tree& operator=(const version_tree&) = delete;
+
         version root_version()
         {
-            return *version_list.begin();
+            return make_version(root_id);
         }
 
         value_type get_value(version v)
         {
-            version_internal<value_type>* impl = (version_internal<value_type>*)v.get_impl();
-            return impl->value;
+            read_guard guard(*this);
+            return versions[v.get_id()].value;
         }
 
+        //only the thread writing where may update it
         void update(version where, const value_type& value)
         {
-            version_internal<value_type>* impl = (version_internal<value_type>*)where.get_impl();
-            impl->value = value;
+            read_guard guard(*this);
+            versions[where.get_id()].value = value;
+        }
+
+        //elements of the structure in v, kept by the structure next to its root
+        size_t get_size(version v)
+        {
+            read_guard guard(*this);
+            return versions[v.get_id()].size;
+        }
+
+        //only the thread writing where may update it
+        void update_size(version where, size_t size)
+        {
+            read_guard guard(*this);
+            versions[where.get_id()].size = (uint32_t)size;
         }
 
         version insert(version where, const value_type& value)
         {
-            version_internal<value_type>* impl = (version_internal<value_type>*)where.get_impl();
-            auto where_it = impl->list_iterator;
-            auto where_next = where_it;
-            where_next++;
-            auto e = impl->end_label;
-            auto f = impl->free_range;
-            if (f < 2)
-            {
-                redistribute();
-            }
-            e = impl->end_label;
-            f = impl->free_range;
-            assert(f >= 2);
-            auto f_step = (f + 1) / 3;
-            assert(f_step >= 1);
-            auto new_beg = e - f - 1 + f_step;
-            auto new_end = new_beg + f_step;
-            auto new_free = new_end - new_beg - 1;
-            assert(new_end < e);
-            impl->free_range = e - new_end - 1;
-            auto it = version_list.insert(where_next, version_internal<value_type>(new_beg, new_end, new_free, value));
-            it->list_iterator = it;
-            return *it;
+            write_guard guard(*this);
+            auto parent = where.get_id();
+            assert(!versions[parent].released);
+            //checked in release builds too: a branch from an old timestamp would
+            //silently see the entries of later timestamps
+            if (is_partial() && parent != newest_id)
+            {
+                throw std::logic_error("partial persistence can't branch from an old version");
+            }
+            auto id = new_version_internal(value, parent);
+            link_child(parent, id);
+            if (is_partial())
+            {
+                newest_id = id;
+                push_timestamp(id);
+                return make_version(id);
+            }
+            //the new interval is nested right before the end of the parent one,
+            //so only labels around the parent end can be touched
+            order.insert_before(end_node(parent), begin_node(id));
+            order.insert_after(begin_node(id), end_node(id));
+            return make_version(id);
+        }
+
+        //the caller promises not to use v anymore, it is removed by the next
+        //collection and its descendants are attached to its parent
+        void release(version v)
+        {
+            write_guard guard(*this);
+            auto id = v.get_id();
+            assert(id != root_id && id != newest_id && !versions[id].released);
+            versions[id].released = true;
+            released_ids.push_back(id);
+        }
+
+        bool is_partial() const
+        {
+            return mode == persistence_mode::partial;
+        }
+
+        bool is_released(const version& v) const
+        {
+            return versions[v.get_id()].released;
+        }
+
+        template <class F>
+        void for_each_live_value(F f)
+        {
+            for (version_id id = 0; id < (version_id)versions.size(); id++)
+            {
+                if (!versions[id].released)
+                {
+                    f(versions[id].value);
+                }
+            }
+        }
+
+        //a collection goes as begin_collection(), then the owner moves or drops every
+        //mod entry of a released version (see get_heirs), then end_collection(),
+        //all under one write_guard
+        void begin_collection()
+        {
+            heirs.clear();
+            for (auto id : released_ids)
+            {
+                if (!heirs.count(id))
+                {
+                    find_heirs(id);
+                }
+            }
+        }
+
+        //an entry of released v has to show up in exactly these versions,
+        //labels of released versions stay valid until end_collection()
+        const std::vector<version>& get_heirs(const version& v) const
+        {
+            auto it = heirs.find(v.get_id());
+            assert(it != heirs.end());
+            return it->second;
+        }
+
+        //removes released versions, no mod entry may refer to them anymore;
+        //on_value gets their values before they are dropped
+        template <class F>
+        void end_collection(F on_value)
+        {
+            for (auto id : released_ids)
+            {
+                splice_out(id);
+                on_value(versions[id].value);
+                versions[id].value = value_type();
+                free_ids.push_back(id);
+            }
+            released_ids.clear();
+            heirs.clear();
+        }
+
+        //number of versions which are not released
+        size_t size() const
+        {
+            return versions.size() - free_ids.size() - released_ids.size();
+        }
+
+        size_t memory_usage() const
+        {
+            return versions.size() * (sizeof(version_internal<value_type>) + 2 * sizeof(label_type));
+        }
+
+        order_list_t::stats get_order_stats() const
+        {
+            return order.get_stats();
         }
     };
 }
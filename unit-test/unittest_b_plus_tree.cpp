@@ -0,0 +1,283 @@
+#include "gtest/gtest.h"
+#include <map>
+#include <set>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "persistent.h"
+
+template <class tree_t>
+static void check_contents(tree_t& tree, const std::map<int, int>& expected, size_t fanout)
+{
+    ASSERT_EQ(tree.size(), expected.size());
+    //every node but the root is at least half full
+    if (expected.size() > 1)
+    {
+        ASSERT_LE(tree.height(), 2 + std::log(expected.size()) / std::log(fanout / 2));
+    }
+    auto e = expected.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++e)
+    {
+        ASSERT_EQ(it->key, e->first);
+        ASSERT_EQ(it->value, e->second);
+    }
+    ASSERT_TRUE(e == expected.end());
+}
+
+template <size_t fanout>
+static void check_insert_orders()
+{
+    const int n = 4096;
+    std::vector<int> sorted(n);
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i] = i;
+    }
+    std::vector<int> reversed(sorted.rbegin(), sorted.rend());
+    std::vector<int> shuffled(sorted);
+    srand(1);
+    for (int i = 1; i < n; i++)
+    {
+        std::swap(shuffled[i], shuffled[rand() % (i + 1)]);
+    }
+
+    for (auto& order : { sorted, reversed, shuffled })
+    {
+        persistent::b_plus_tree<int, int, fanout> tree;
+        std::map<int, int> expected;
+        for (int key : order)
+        {
+            tree.insert(key, -key);
+            expected[key] = -key;
+        }
+        check_contents(tree, expected, fanout);
+        ASSERT_EQ(tree.find(n / 2)->value, -n / 2);
+        ASSERT_TRUE(tree.find(n) == tree.end());
+        ASSERT_TRUE(tree.find(-1) == tree.end());
+    }
+}
+
+TEST(test_b_plus_tree, test_insert_orders)
+{
+    check_insert_orders<4>();
+    check_insert_orders<persistent::default_fanout>();
+}
+
+TEST(test_b_plus_tree, test_erase)
+{
+    //small nodes, so erases merge and borrow on every level
+    persistent::b_plus_tree<int, int, 4> tree;
+    std::map<int, int> expected;
+    for (int i = 0; i < 1000; i++)
+    {
+        tree.insert(i, i);
+        expected[i] = i;
+    }
+    //erase returns the next key
+    auto it = tree.erase(tree.find(500));
+    expected.erase(500);
+    ASSERT_EQ(it->key, 501);
+    for (int i = 0; i < 1000; i += 3)
+    {
+        tree.erase(tree.find(i));
+        expected.erase(i);
+    }
+    check_contents(tree, expected, 4);
+    ASSERT_TRUE(tree.erase(tree.find(999)) == tree.end());
+    expected.erase(999);
+    for (int i = 998; i > 500; i--)
+    {
+        tree.erase(tree.find(i));
+        expected.erase(i);
+    }
+    check_contents(tree, expected, 4);
+    while (tree.begin() != tree.end())
+    {
+        tree.erase(tree.begin());
+    }
+    ASSERT_EQ(tree.size(), 0);
+    ASSERT_EQ(tree.height(), 0);
+}
+
+TEST(test_b_plus_tree, test_batch)
+{
+    //a batch makes one version, its nodes are written in place after their first copy
+    persistent::b_plus_tree<int, int, 8> tree;
+    tree.insert(0, 0);
+    auto before = tree.get_version();
+    std::map<int, int> expected;
+    expected[0] = 0;
+    {
+        auto batch = tree.batch();
+        for (int i = 1; i < 500; i++)
+        {
+            tree.insert(i * 7 % 500, i);
+            expected[i * 7 % 500] = i;
+        }
+        for (int i = 0; i < 500; i += 4)
+        {
+            tree.erase(tree.find(i));
+            expected.erase(i);
+        }
+    }
+    check_contents(tree, expected, 8);
+    tree.set_version(before);
+    ASSERT_EQ(tree.size(), 1);
+}
+
+//has no default constructor, and counts the values alive
+struct slot_value
+{
+    static int alive;
+    int value;
+
+    explicit slot_value(int value) :
+        value(value)
+    {
+        alive++;
+    }
+
+    slot_value(const slot_value& v) :
+        value(v.value)
+    {
+        alive++;
+    }
+
+    slot_value& operator=(const slot_value& v) = default;
+
+    ~slot_value()
+    {
+        alive--;
+    }
+
+    bool operator==(const slot_value& v) const
+    {
+        return value == v.value;
+    }
+};
+
+int slot_value::alive = 0;
+
+TEST(test_b_plus_tree, test_value_slots)
+{
+    //leaves hold a value per key, inner nodes none. in one batch every node is
+    //written in place, so no older version keeps values either
+    {
+        persistent::b_plus_tree<int, slot_value, 8> tree;
+        std::map<int, int> expected;
+        {
+            auto batch = tree.batch();
+            for (int i = 0; i < 1000; i++)
+            {
+                tree.insert(i * 7 % 1000, slot_value(i));
+                expected[i * 7 % 1000] = i;
+            }
+            for (int i = 0; i < 1000; i += 3)
+            {
+                tree.erase(tree.find(i));
+                expected.erase(i);
+            }
+        }
+        ASSERT_EQ(slot_value::alive, (int)expected.size());
+        auto e = expected.begin();
+        for (auto it = tree.begin(); it != tree.end(); ++it, ++e)
+        {
+            ASSERT_EQ(it->key, e->first);
+            ASSERT_EQ(it->value.value, e->second);
+        }
+    }
+    ASSERT_EQ(slot_value::alive, 0);
+}
+
+//random edits with branches from older versions, every version keeps its
+//contents after the splits and merges of the later ones
+template <size_t fanout>
+static void check_versions()
+{
+    persistent::b_plus_tree<int, int, fanout> tree;
+    std::map<int, int> expected;
+    std::vector<std::pair<persistent::version, std::map<int, int>>> history;
+    srand(5);
+    for (int i = 0; i < 3000; i++)
+    {
+        int key = rand() % 200;
+        if (rand() % 3 == 0)
+        {
+            tree.erase(tree.find(key));
+            expected.erase(key);
+        }
+        else
+        {
+            tree.insert(key, i);
+            expected[key] = i;
+        }
+        history.push_back(std::make_pair(tree.get_version(), expected));
+        if (i % 500 == 499)
+        {
+            auto& h = history[rand() % history.size()];
+            tree.set_version(h.first);
+            expected = h.second;
+        }
+    }
+
+    for (size_t i = 0; i < history.size(); i += 7)
+    {
+        tree.set_version(history[i].first);
+        check_contents(tree, history[i].second, fanout);
+    }
+
+    //released versions drop the nodes only they saw, an edit which changes
+    //nothing makes no version, and the newest one can't be released
+    persistent::version_id newest = 0;
+    for (auto& h : history)
+    {
+        newest = std::max(newest, h.first.get_id());
+    }
+    std::vector<std::pair<persistent::version, std::map<int, int>>> kept;
+    std::set<persistent::version_id> kept_ids;
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        auto& v = history[i].first;
+        if (i % 50 == 0 || i + 1 == history.size() || v.get_id() == newest)
+        {
+            kept.push_back(history[i]);
+            kept_ids.insert(v.get_id());
+        }
+    }
+    tree.set_version(kept.back().first);
+    std::set<persistent::version_id> released;
+    for (auto& h : history)
+    {
+        if (!kept_ids.count(h.first.get_id()) && released.insert(h.first.get_id()).second)
+        {
+            tree.release_version(h.first);
+        }
+    }
+    tree.collect_garbage();
+    for (auto& h : kept)
+    {
+        tree.set_version(h.first);
+        check_contents(tree, h.second, fanout);
+    }
+
+    //versions made after the collection reuse the released ids, and copy the old nodes
+    tree.set_version(kept.back().first);
+    expected = kept.back().second;
+    for (int i = 0; i < 300; i++)
+    {
+        tree.insert(i, -i);
+        expected[i] = -i;
+    }
+    check_contents(tree, expected, fanout);
+    for (auto& h : kept)
+    {
+        tree.set_version(h.first);
+        check_contents(tree, h.second, fanout);
+    }
+}
+
+TEST(test_b_plus_tree, test_versions)
+{
+    check_versions<4>();
+    check_versions<persistent::default_fanout>();
+}
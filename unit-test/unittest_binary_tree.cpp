@@ -1,5 +1,64 @@
 #include "gtest/gtest.h"
+#include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 #include "persistent.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fstream>
+#include <unistd.h>
+#endif
+
+struct counted_value
+{
+    static int alive;
+    int value;
+
+    counted_value(int value = 0) :
+        value(value)
+    {
+        alive++;
+    }
+
+    counted_value(const counted_value& v) :
+        value(v.value)
+    {
+        alive++;
+    }
+
+    counted_value& operator=(const counted_value& v) = default;
+
+    ~counted_value()
+    {
+        alive--;
+    }
+
+    bool operator==(const counted_value& v) const
+    {
+        return value == v.value;
+    }
+};
+
+int counted_value::alive = 0;
+
+static size_t resident_bytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.WorkingSetSize;
+#else
+    size_t pages = 0;
+    size_t resident = 0;
+    std::ifstream("/proc/self/statm") >> pages >> resident;
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
 
 static persistent::binary_tree<int, int> construct_random_tree(int size)
 {
@@ -109,6 +168,194 @@ TEST(test_binary_tree, test_erase)
     ASSERT_EQ(bst.size(), n - 1);
 }
 
+TEST(test_binary_tree, test_bounds)
+{
+    persistent::binary_tree<int, int> bst;
+    std::map<int, int> expected;
+    srand(3);
+    for (int i = 0; i < 200; i++)
+    {
+        int key = rand() % 100 * 2;
+        bst.insert(key, i);
+        expected[key] = i;
+    }
+    auto old_version = bst.get_version();
+    auto old_expected = expected;
+    for (int key = 0; key < 200; key += 6)
+    {
+        bst.erase(bst.find(key));
+        expected.erase(key);
+    }
+
+    //bounds of the current version, and of the old one through a tree at it
+    auto old_bst = bst.create_with_version(old_version);
+    for (auto* t : { &bst, &old_bst })
+    {
+        auto& e = t == &bst ? expected : old_expected;
+        for (int key = -1; key <= 200; key++)
+        {
+            auto lower = t->lower_bound(key);
+            auto upper = t->upper_bound(key);
+            ASSERT_EQ(lower == t->end(), e.lower_bound(key) == e.end());
+            ASSERT_EQ(upper == t->end(), e.upper_bound(key) == e.end());
+            if (lower != t->end())
+            {
+                ASSERT_EQ(lower->key, e.lower_bound(key)->first);
+            }
+            if (upper != t->end())
+            {
+                ASSERT_EQ(upper->key, e.upper_bound(key)->first);
+            }
+            auto range = t->equal_range(key);
+            ASSERT_EQ(range.first != range.second, e.count(key) == 1);
+        }
+
+        std::vector<int> keys;
+        for (auto& kv : t->range(51, 121))
+        {
+            keys.push_back(kv.key);
+        }
+        std::vector<int> expected_keys;
+        for (auto it = e.lower_bound(51); it != e.lower_bound(121); ++it)
+        {
+            expected_keys.push_back(it->first);
+        }
+        ASSERT_EQ(keys, expected_keys);
+        ASSERT_TRUE(t->range(120, 120).empty());
+        ASSERT_TRUE(t->range(120, 10).empty());
+    }
+}
+
+//subtree counts follow inserts, erases and splits in every version
+TEST(test_binary_tree, test_rank_select)
+{
+    persistent::binary_tree<int, int, false, 2, true> bst;
+    std::set<int> expected;
+    std::vector<std::pair<persistent::version, std::set<int>>> history;
+    srand(8);
+    for (int i = 0; i < 2000; i++)
+    {
+        int key = rand() % 300;
+        if (rand() % 3 == 0)
+        {
+            bst.erase(bst.find(key));
+            expected.erase(key);
+        }
+        else
+        {
+            bst.insert(key, i);
+            expected.insert(key);
+        }
+        if (i % 100 == 0)
+        {
+            history.push_back(std::make_pair(bst.get_version(), expected));
+        }
+    }
+    history.push_back(std::make_pair(bst.get_version(), expected));
+
+    for (auto& h : history)
+    {
+        bst.set_version(h.first);
+        ASSERT_EQ(bst.size(), h.second.size());
+        size_t index = 0;
+        for (int key : h.second)
+        {
+            ASSERT_EQ(bst.rank(key), index);
+            ASSERT_EQ(bst.rank(key + 1), index + 1);
+            auto it = bst.select(index);
+            ASSERT_EQ(it->key, key);
+            //iterators of select() go on in order
+            if (++it != bst.end())
+            {
+                ASSERT_EQ(it->key, *h.second.upper_bound(key));
+            }
+            index++;
+        }
+        ASSERT_TRUE(bst.select(index) == bst.end());
+    }
+}
+
+TEST(test_binary_tree, test_from_sorted)
+{
+    const int n = 1000;
+    std::vector<std::pair<int, int>> entries;
+    for (int i = 0; i < n; i++)
+    {
+        entries.push_back(std::make_pair(i, -i));
+    }
+    auto bst = persistent::binary_tree<int, int>::from_sorted(entries.begin(), entries.end());
+    ASSERT_EQ(bst.size(), n);
+    //perfectly balanced, 2^10 > n
+    ASSERT_EQ(bst.height(), 10);
+    int key = 0;
+    for (auto& e : bst)
+    {
+        ASSERT_EQ(e.key, key);
+        ASSERT_EQ(e.value, -key);
+        key++;
+    }
+    bst.insert(n, 0);
+    ASSERT_EQ(bst.size(), n + 1);
+}
+
+TEST(test_binary_tree, test_assign_sorted)
+{
+    persistent::binary_tree<int, int> bst;
+    for (int i = 0; i < 10; i++)
+    {
+        bst.insert(i, i);
+    }
+    auto old_version = bst.get_version();
+
+    //unsorted input is sorted, of equal keys the last one stays
+    std::vector<std::pair<int, int>> entries;
+    std::map<int, int> expected;
+    srand(4);
+    for (int i = 0; i < 50000; i++)
+    {
+        int key = rand() % 20000;
+        entries.push_back(std::make_pair(key, i));
+        expected[key] = i;
+    }
+    bst.assign_sorted(entries.begin(), entries.end());
+    ASSERT_EQ(bst.get_version().get_id(), old_version.get_id() + 1);
+    ASSERT_EQ(bst.size(), expected.size());
+    ASSERT_LE(bst.height(), 15);
+    auto e = expected.begin();
+    for (auto it = bst.begin(); it != bst.end(); ++it, ++e)
+    {
+        ASSERT_EQ(it->key, e->first);
+        ASSERT_EQ(it->value, e->second);
+    }
+
+    //the version it was assigned over keeps its keys
+    bst.set_version(old_version);
+    ASSERT_EQ(bst.size(), 10);
+    ASSERT_EQ(bst.find(5)->value, 5);
+}
+
+TEST(test_binary_tree, test_parallel_sort)
+{
+    std::vector<std::pair<int, int>> items;
+    srand(6);
+    for (int i = 0; i < 100000; i++)
+    {
+        items.push_back(std::make_pair(rand() % 1000, i));
+    }
+    auto expected = items;
+    auto less = [](const std::pair<int, int>& a, const std::pair<int, int>& b)
+    {
+        return a.first < b.first;
+    };
+    std::stable_sort(expected.begin(), expected.end(), less);
+    for (size_t threads : { 1, 2, 3, 8 })
+    {
+        auto sorted = items;
+        persistent::parallel_stable_sort(sorted, less, threads);
+        ASSERT_EQ(sorted, expected);
+    }
+}
+
 TEST(test_binary_tree, test_nested1)
 {
     persistent::binary_tree<int, persistent::binary_tree<int, int>> bst;
@@ -170,3 +417,713 @@ TEST(test_binary_tree, test_nested2)
         ASSERT_TRUE(val.begin()->value == i + 1);
     }
 }
+
+TEST(test_binary_tree, test_collect_garbage)
+{
+    const int n = 50;
+    {
+        persistent::binary_tree<int, counted_value> bst;
+        for (int i = 0; i < n; i++)
+        {
+            bst.insert(i * 2, counted_value(i));
+        }
+        auto base = bst.get_version();
+        int alive_base = counted_value::alive;
+
+        std::vector<persistent::version> branch;
+        for (int i = 0; i < n; i++)
+        {
+            bst.insert(i * 2 + 1, counted_value(i));
+            branch.push_back(bst.get_version());
+        }
+        ASSERT_GT(counted_value::alive, alive_base);
+
+        bst.set_version(base);
+        for (auto& v : branch)
+        {
+            bst.release_version(v);
+        }
+        bst.collect_garbage();
+
+        ASSERT_LE(counted_value::alive, alive_base);
+        ASSERT_EQ(bst.size(), n);
+        for (int i = 0; i < n; i++)
+        {
+            ASSERT_EQ(bst.find(i * 2)->value.value, i);
+            ASSERT_TRUE(bst.find(i * 2 + 1) == bst.end());
+        }
+
+        //released ids are reused by new versions
+        bst.insert(-1, counted_value(-1));
+        ASSERT_EQ(bst.size(), n + 1);
+        ASSERT_EQ(bst.find(-1)->value.value, -1);
+    }
+}
+
+TEST(test_binary_tree, test_collapse_released)
+{
+    const int n = 30;
+    persistent::binary_tree<int, int> bst;
+    std::vector<persistent::version> released;
+    for (int i = 0; i < n; i++)
+    {
+        bst.insert(i * 2, i);
+        released.push_back(bst.get_version());
+    }
+    bst.insert(1, -1);
+    released.push_back(bst.get_version());
+    bst.insert(3, -3);
+    auto a = bst.get_version();
+    bst.set_version(released.back());
+    bst.insert(5, -5);
+    auto b = bst.get_version();
+
+    //the released versions are interior, their changes move into both branches
+    for (auto& v : released)
+    {
+        bst.release_version(v);
+    }
+    bst.collect_garbage();
+
+    ASSERT_EQ(bst.size(), n + 2);
+    ASSERT_EQ(bst.find(5)->value, -5);
+    ASSERT_TRUE(bst.find(3) == bst.end());
+    bst.set_version(a);
+    ASSERT_EQ(bst.size(), n + 2);
+    ASSERT_EQ(bst.find(1)->value, -1);
+    ASSERT_EQ(bst.find(3)->value, -3);
+    ASSERT_TRUE(bst.find(5) == bst.end());
+    for (int i = 0; i < n; i++)
+    {
+        ASSERT_EQ(bst.find(i * 2)->value, i);
+    }
+
+    bst.set_version(b);
+    ASSERT_EQ(bst.size(), n + 2);
+    ASSERT_EQ(bst.find(1)->value, -1);
+    ASSERT_EQ(bst.find(5)->value, -5);
+    ASSERT_TRUE(bst.find(3) == bst.end());
+    for (int i = 0; i < n; i++)
+    {
+        ASSERT_EQ(bst.find(i * 2)->value, i);
+    }
+}
+
+TEST(test_binary_tree, test_retention)
+{
+    const int n = 200;
+    persistent::binary_tree<int, int> all;
+    persistent::binary_tree<int, int> bst;
+    bst.set_retention_policy(persistent::retention_policy::keep_last(4));
+    persistent::version tagged;
+    for (int i = 0; i < n; i++)
+    {
+        all.insert(n - i, i);
+        bst.insert(n - i, i);
+        if (i == n / 2)
+        {
+            tagged = bst.get_version();
+            bst.tag_version(tagged);
+        }
+    }
+    ASSERT_LT(bst.prune_history(), all.prune_history());
+    ASSERT_EQ(bst.size(), n);
+    for (int i = 0; i < n; i++)
+    {
+        ASSERT_EQ(bst.find(n - i)->value, i);
+    }
+
+    bst.set_version(tagged);
+    ASSERT_EQ(bst.size(), n / 2 + 1);
+    for (int i = 0; i <= n / 2; i++)
+    {
+        ASSERT_EQ(bst.find(n - i)->value, i);
+    }
+}
+
+//ages count every version, pruned ones too, so after many prunes old history
+//still has one or two versions per power of two of age
+TEST(test_binary_tree, test_geometric_retention)
+{
+    const size_t n = 5000;
+    persistent::binary_tree<int, int> bst;
+    bst.set_retention_policy(persistent::retention_policy::geometric(4));
+    //ids of released versions are reused, an id maps to its newest version
+    std::map<persistent::version_id, size_t> steps;
+    for (size_t i = 0; i < n; i++)
+    {
+        bst.insert((int)(i % 100), (int)i);
+        steps[bst.get_version().get_id()] = i;
+    }
+    std::vector<size_t> ages;
+    for (auto& v : bst.get_retained_versions())
+    {
+        ages.push_back(n - 1 - steps[v.get_id()]);
+    }
+    ASSERT_GE(*std::max_element(ages.begin(), ages.end()), n / 2);
+    for (size_t range = 32; range * 2 <= n; range *= 2)
+    {
+        auto in_range = std::count_if(ages.begin(), ages.end(), [&](size_t age)
+        {
+            return age >= range && age < range * 2;
+        });
+        ASSERT_GE(in_range, 1);
+        ASSERT_LE(in_range, 2);
+    }
+}
+
+TEST(test_binary_tree, test_memory_budget)
+{
+    const int n = 200;
+    persistent::binary_tree<int, int> all;
+    persistent::binary_tree<int, int> bst;
+    for (int i = 0; i < n; i++)
+    {
+        all.insert(i, i);
+    }
+    size_t budget = all.prune_history() / 2;
+
+    bst.set_retention_policy(persistent::retention_policy::keep_all().with_memory_budget(budget));
+    for (int i = 0; i < n; i++)
+    {
+        bst.insert(i, i);
+    }
+    ASSERT_LT(bst.prune_history(), all.prune_history());
+    ASSERT_EQ(bst.size(), n);
+    for (int i = 0; i < n; i++)
+    {
+        ASSERT_EQ(bst.find(i)->value, i);
+    }
+}
+
+TEST(test_binary_tree, test_partial_persistence)
+{
+    const int n = 300;
+    persistent::binary_tree<int, int> bst(persistent::persistence_mode::partial);
+    std::vector<persistent::version> versions;
+    for (int i = 0; i < n; i++)
+    {
+        bst.insert((i * 7) % n, i);
+        versions.push_back(bst.get_version());
+    }
+    for (int i = 0; i < n; i += 10)
+    {
+        bst.set_version(versions[i]);
+        ASSERT_EQ(bst.size(), i + 1);
+        for (int j = 0; j <= i; j++)
+        {
+            ASSERT_EQ(bst.find((j * 7) % n)->value, j);
+        }
+    }
+}
+
+TEST(test_binary_tree, test_partial_retention)
+{
+    const int n = 300;
+    persistent::binary_tree<int, int> bst(persistent::persistence_mode::partial);
+    bst.set_retention_policy(persistent::retention_policy::keep_last(8));
+    persistent::version tagged;
+    for (int i = 0; i < n; i++)
+    {
+        bst.insert((i * 7) % n, i);
+        if (i == n / 2)
+        {
+            tagged = bst.get_version();
+            bst.tag_version(tagged);
+        }
+    }
+
+    //collapsed entries keep boxes in timestamp order
+    bst.prune_history();
+    ASSERT_EQ(bst.size(), n);
+    for (int j = 0; j < n; j++)
+    {
+        ASSERT_EQ(bst.find((j * 7) % n)->value, j);
+    }
+    bst.set_version(tagged);
+    ASSERT_EQ(bst.size(), n / 2 + 1);
+    for (int j = 0; j <= n / 2; j++)
+    {
+        ASSERT_EQ(bst.find((j * 7) % n)->value, j);
+    }
+}
+
+TEST(test_binary_tree, test_one_version_per_operation)
+{
+    persistent::binary_tree<int, int> bst;
+    auto v0 = bst.get_version();
+    bst[1] = 10;
+    ASSERT_EQ(bst.get_version().get_id(), v0.get_id() + 1);
+
+    //writing a value which is already there makes no version
+    auto v1 = bst.get_version();
+    bst.insert(1, 10);
+    bst[1];
+    ASSERT_TRUE(bst.get_version() == v1);
+
+    bst.insert(1, 11);
+    ASSERT_EQ(bst.get_version().get_id(), v1.get_id() + 1);
+    ASSERT_EQ(bst.find(1)->value, 11);
+
+    persistent::binary_tree<int, persistent::vector<int>> nested;
+    nested[0].push_back(1);
+    auto v2 = nested.get_version();
+    nested.find(0)->value.push_back(2);
+    ASSERT_EQ(nested.get_version().get_id(), v2.get_id() + 1);
+    ASSERT_EQ(nested.find(0)->value.size(), 2);
+}
+
+TEST(test_binary_tree, test_batch)
+{
+    const int n = 100;
+    persistent::binary_tree<int, int> bst;
+    bst.insert(-1, -1);
+    auto v0 = bst.get_version();
+    {
+        auto batch = bst.batch();
+        for (int i = 0; i < n; i++)
+        {
+            bst.insert(i, i);
+        }
+        bst.erase(bst.find(-1));
+    }
+    ASSERT_EQ(bst.get_version().get_id(), v0.get_id() + 1);
+    ASSERT_EQ(bst.size(), n);
+
+    bst.set_version(v0);
+    ASSERT_EQ(bst.size(), 1);
+    ASSERT_EQ(bst.find(-1)->value, -1);
+}
+
+TEST(test_binary_tree, test_overwrite_mod)
+{
+    typedef persistent::binary_tree_node<int, int> node_t;
+    persistent::version_tree<node_t::node_ptr_t> vtree;
+    auto v = vtree.insert(vtree.root_version(), node_t::node_ptr_t());
+    node_t::version_context_t vc(nullptr, v, &vtree);
+    node_t::node_pool_t pool;
+    auto node = pool.create(0, 0, vc);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(node->set_value(i, vc), node);
+    }
+    ASSERT_EQ(node->get_value(vc), 9);
+    ASSERT_FALSE(node->is_mod_box_full());
+    int entries = 0;
+    node->mod_box.for_each([&](const node_t::mod_box_entry&)
+    {
+        entries++;
+    });
+    ASSERT_EQ(entries, 1);
+}
+
+template <bool fat_node>
+static void check_concurrent_branches()
+{
+    //branches write odd keys between the even ones of base, so every write goes through shared nodes
+    typedef persistent::binary_tree<int, int, fat_node> tree_t;
+    tree_t base;
+    for (int i = 0; i < 1000; i++)
+    {
+        base.insert(i * 7 % 1000 * 2, i);
+    }
+    auto base_version = base.get_version();
+
+    const int threads = 4;
+    const int writes = 250;
+    std::vector<tree_t> branches;
+    for (int i = 0; i < threads; i++)
+    {
+        branches.push_back(base.create_with_version(base_version));
+    }
+    std::atomic<bool> start(false);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+    {
+        workers.push_back(std::thread([&, i]()
+        {
+            while (!start)
+            {
+            }
+            for (int k = 0; k < writes; k++)
+            {
+                branches[i].insert((k * threads + i) * 2 + 1, i);
+            }
+        }));
+    }
+    start = true;
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        auto& branch = branches[i];
+        ASSERT_EQ(branch.size(), 1000 + writes);
+        for (int k = 0; k < writes; k++)
+        {
+            ASSERT_NE(branch.find((k * threads + i) * 2 + 1), branch.end());
+            ASSERT_EQ(branch.find((k * threads + (i + 1) % threads) * 2 + 1), branch.end());
+        }
+    }
+    base.set_version(base_version);
+    ASSERT_EQ(base.size(), 1000);
+}
+
+TEST(test_binary_tree, test_concurrent_branches)
+{
+    check_concurrent_branches<false>();
+    //fat nodes are shared by every branch, their entries must stay where readers found them
+    check_concurrent_branches<true>();
+}
+
+TEST(test_binary_tree, test_compact_mod_entry)
+{
+    typedef persistent::binary_tree_node<int, counted_value> node_t;
+    typedef node_t::mod_box_entry entry_t;
+    persistent::version_tree<node_t::node_ptr_t> vtree;
+    auto v = vtree.root_version();
+    node_t::version_context_t vc(nullptr, v, &vtree);
+    node_t::node_pool_t pool;
+    auto node = pool.create(0, counted_value(), vc);
+    int alive_base = counted_value::alive;
+
+    //an entry holds either a value or a 32-bit link, never both
+    ASSERT_LE(sizeof(entry_t), sizeof(persistent::version) + sizeof(counted_value) + sizeof(persistent::node_id));
+    {
+        std::vector<entry_t> box(8);
+        box[0] = entry_t::make<node_t::value_field>(v, counted_value(1));
+        box[1] = entry_t::make<node_t::left_field>(v, node.get_id());
+        ASSERT_EQ(counted_value::alive, alive_base + 1);
+
+        auto copy = box;
+        ASSERT_EQ(counted_value::alive, alive_base + 2);
+        ASSERT_EQ(copy[0].get<node_t::value_field>().value, 1);
+        ASSERT_EQ(node.at(copy[1].get<node_t::left_field>()), node);
+
+        copy[0] = copy[1];
+        ASSERT_EQ(counted_value::alive, alive_base + 1);
+        ASSERT_EQ(copy[0].field(), node_t::left_field);
+        ASSERT_EQ(copy[0].get<node_t::left_field>(), node.get_id());
+    }
+    ASSERT_EQ(counted_value::alive, alive_base);
+
+    //entries of trivial types are copied as raw bytes
+    typedef persistent::binary_tree_node<int, int>::mod_box_entry int_entry_t;
+    ASSERT_TRUE(std::is_trivially_copyable<int_entry_t>::value);
+    ASSERT_FALSE(std::is_trivially_copyable<entry_t>::value);
+}
+
+TEST(test_binary_tree, test_node_pool)
+{
+    typedef persistent::binary_tree_node<int, counted_value> node_t;
+    persistent::version_tree<node_t::node_ptr_t> vtree;
+    node_t::version_context_t vc(nullptr, vtree.root_version(), &vtree);
+    int alive_base = counted_value::alive;
+    {
+        node_t::node_pool_t pool;
+        std::vector<node_t::node_ptr_t> nodes;
+        for (int i = 0; i < 1000; i++)
+        {
+            nodes.push_back(pool.create(i, counted_value(i), vc, nodes.empty() ? node_t::node_ptr_t() : nodes.back()));
+        }
+        ASSERT_EQ(counted_value::alive, alive_base + 1000);
+        for (int i = 0; i < 1000; i++)
+        {
+            ASSERT_EQ(nodes[i]->key, i);
+            ASSERT_EQ(nodes[i]->get_value(vc).value, i);
+            ASSERT_EQ(nodes[i]->get_left(vc), i ? nodes[i - 1] : node_t::node_ptr_t());
+        }
+
+        //freed ids are handed out again
+        for (int i = 0; i < 1000; i += 2)
+        {
+            pool.destroy(nodes[i].get_id());
+        }
+        ASSERT_EQ(pool.size(), 500);
+        ASSERT_EQ(counted_value::alive, alive_base + 500);
+        for (int i = 0; i < 500; i++)
+        {
+            ASSERT_LT(pool.create(i, counted_value(), vc).get_id(), 1000);
+        }
+        ASSERT_EQ(pool.id_bound(), 1000);
+    }
+    ASSERT_EQ(counted_value::alive, alive_base);
+}
+
+template <size_t mod_box_size>
+static void check_history_with_mod_box_size()
+{
+    persistent::binary_tree<int, int, false, mod_box_size> bst;
+    std::vector<persistent::version> versions;
+    std::vector<int> keys;
+    srand(5);
+    for (int i = 0; i < 200; i++)
+    {
+        keys.push_back(rand());
+        bst.insert(keys.back(), i);
+        versions.push_back(bst.get_version());
+    }
+    for (int i = 0; i < 200; i += 7)
+    {
+        bst.set_version(versions[i]);
+        ASSERT_EQ(bst.size(), i + 1);
+        for (int k = 0; k < 200; k++)
+        {
+            ASSERT_EQ(bst.find(keys[k]) != bst.end(), k <= i);
+        }
+    }
+}
+
+TEST(test_binary_tree, test_mod_box_size)
+{
+    check_history_with_mod_box_size<2>();
+    check_history_with_mod_box_size<4>();
+    check_history_with_mod_box_size<16>();
+
+    //boxes grown past their size move out of the node and back
+    persistent::inline_mod_box<int, 4> box;
+    ASSERT_TRUE(box.is_inline());
+    std::vector<int> entries = { 1, 2, 3, 4, 5, 6 };
+    box.assign(entries.begin(), entries.end());
+    ASSERT_FALSE(box.is_inline());
+    ASSERT_EQ(box.size(), 6);
+    entries.resize(3);
+    box.assign(entries.begin(), entries.end());
+    ASSERT_TRUE(box.is_inline());
+    ASSERT_EQ(box.size(), 4);
+    ASSERT_EQ(box[2], 3);
+    ASSERT_EQ(box.back(), 0);
+}
+
+template <size_t mod_box_size>
+static void check_writes_with_splits()
+{
+    persistent::binary_tree<int, int, false, mod_box_size> bst;
+    std::map<int, int> expected;
+    std::vector<std::pair<persistent::version, std::map<int, int>>> history;
+    srand(7);
+    for (int i = 0; i < 3000; i++)
+    {
+        int key = rand() % 64;
+        if (rand() % 3 == 0)
+        {
+            bst.erase(bst.find(key));
+            expected.erase(key);
+        }
+        else
+        {
+            bst.insert(key, i);
+            expected[key] = i;
+        }
+        if (i % 50 == 0)
+        {
+            history.push_back(std::make_pair(bst.get_version(), expected));
+        }
+    }
+    history.push_back(std::make_pair(bst.get_version(), expected));
+
+    for (auto& h : history)
+    {
+        bst.set_version(h.first);
+        ASSERT_EQ(bst.size(), h.second.size());
+        auto e = h.second.begin();
+        for (auto it = bst.begin(); it != bst.end(); ++it, ++e)
+        {
+            ASSERT_EQ(it->key, e->first);
+            ASSERT_EQ(it->value, e->second);
+        }
+    }
+}
+
+TEST(test_binary_tree, test_writes_with_splits)
+{
+    check_writes_with_splits<2>();
+    check_writes_with_splits<4>();
+    check_writes_with_splits<8>();
+}
+
+TEST(test_binary_tree, test_no_back_pointers)
+{
+    persistent::binary_tree<int, int> bst;
+    bst.insert(50, 0);
+    bst.insert(25, 0);
+    bst.insert(75, 0);
+    auto stats = bst.get_node_stats();
+    ASSERT_EQ(stats.nodes, 3);
+    ASSERT_EQ(stats.mod_entries, 2);
+
+    //a new leaf costs its node and the link to it, children don't link back
+    bst.insert(10, 0);
+    stats = bst.get_node_stats();
+    ASSERT_EQ(stats.nodes, 4);
+    ASSERT_EQ(stats.mod_entries, 3);
+
+    //iterators of find() find their way up from the key
+    auto it = bst.find(10);
+    ASSERT_EQ((++it)->key, 25);
+    ASSERT_EQ((++it)->key, 50);
+
+    //erase relinks the parent only
+    it = bst.erase(bst.find(25));
+    ASSERT_EQ(it->key, 50);
+    stats = bst.get_node_stats();
+    ASSERT_EQ(stats.nodes, 4);
+    ASSERT_EQ(stats.mod_entries, 4);
+    std::vector<int> keys;
+    for (auto e = bst.begin(); e != bst.end(); ++e)
+    {
+        keys.push_back(e->key);
+    }
+    ASSERT_EQ(keys, std::vector<int>({ 10, 50, 75 }));
+}
+
+template <bool fat_node>
+static void check_history_after_collection()
+{
+    persistent::binary_tree<int, int, fat_node> bst;
+    std::map<int, int> expected;
+    std::vector<std::pair<persistent::version, std::map<int, int>>> history;
+    srand(9);
+    for (int i = 0; i < 2000; i++)
+    {
+        int key = rand() % 32;
+        if (rand() % 4 == 0)
+        {
+            bst.erase(bst.find(key));
+            expected.erase(key);
+        }
+        else
+        {
+            bst.insert(key, i);
+            expected[key] = i;
+        }
+        history.push_back(std::make_pair(bst.get_version(), expected));
+        //branch off an older version now and then
+        if (i % 100 == 99)
+        {
+            auto& h = history[rand() % history.size()];
+            bst.set_version(h.first);
+            expected = h.second;
+        }
+    }
+
+    //every version but a few is released, their entries move into the kept ones.
+    //the current and the newest version can't be released
+    persistent::version_id newest = 0;
+    for (auto& h : history)
+    {
+        newest = std::max(newest, h.first.get_id());
+    }
+    std::vector<std::pair<persistent::version, std::map<int, int>>> kept;
+    std::set<persistent::version_id> kept_ids;
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        auto& v = history[i].first;
+        if (i % 37 == 0 || v == bst.get_version() || v.get_id() == newest)
+        {
+            kept.push_back(history[i]);
+            kept_ids.insert(v.get_id());
+        }
+    }
+    std::set<persistent::version_id> released;
+    for (auto& h : history)
+    {
+        if (!kept_ids.count(h.first.get_id()) && released.insert(h.first.get_id()).second)
+        {
+            bst.release_version(h.first);
+        }
+    }
+    bst.collect_garbage();
+
+    for (auto& h : kept)
+    {
+        bst.set_version(h.first);
+        ASSERT_EQ(bst.size(), h.second.size());
+        auto e = h.second.begin();
+        for (auto it = bst.begin(); it != bst.end(); ++it, ++e)
+        {
+            ASSERT_EQ(it->key, e->first);
+            ASSERT_EQ(it->value, e->second);
+        }
+    }
+}
+
+TEST(test_binary_tree, test_fat_nodes)
+{
+    check_history_after_collection<true>();
+    check_history_after_collection<false>();
+
+    //a fat node never splits, its fields keep every version
+    typedef persistent::binary_tree_node<int, int, true> node_t;
+    persistent::version_tree<node_t::node_ptr_t> vtree;
+    node_t::node_pool_t pool;
+    auto v = vtree.root_version();
+    auto node = pool.create(0, 0, node_t::version_context_t(nullptr, v, &vtree));
+    std::vector<persistent::version> versions;
+    for (int i = 0; i < 100; i++)
+    {
+        v = vtree.insert(i % 3 ? v : vtree.root_version(), node);
+        ASSERT_EQ(node->set_value(i, node_t::version_context_t(nullptr, v, &vtree)), node);
+        versions.push_back(v);
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(node->get_value(node_t::version_context_t(nullptr, versions[i], &vtree)), i);
+    }
+
+    //many later siblings lie between a version and the ancestor holding its value
+    auto base = versions[0];
+    std::vector<persistent::version> leaves;
+    for (int i = 0; i < 300; i++)
+    {
+        auto branch = vtree.insert(base, node);
+        if (i % 2 == 0)
+        {
+            node->set_value(1000 + i, node_t::version_context_t(nullptr, branch, &vtree));
+        }
+        leaves.push_back(vtree.insert(branch, node));
+    }
+    for (int i = 0; i < 300; i++)
+    {
+        ASSERT_EQ(node->get_value(node_t::version_context_t(nullptr, leaves[i], &vtree)), i % 2 == 0 ? 1000 + i : 0);
+    }
+}
+
+TEST(test_binary_tree, test_dropped_trees_free_memory)
+{
+    //many short lived maps, each with a history, dropped with every version alive
+    auto churn = []()
+    {
+        for (int i = 0; i < 2000; i++)
+        {
+            persistent::binary_tree<int, int> bst;
+            for (int k = 0; k < 100; k++)
+            {
+                bst.insert(k * 37 % 101, k);
+            }
+            bst.erase(bst.find(0));
+
+            persistent::linked_list<int> l;
+            for (int k = 0; k < 100; k++)
+            {
+                l.push_front(k);
+            }
+            l.pop_front();
+        }
+    };
+
+    //the first round warms up the allocator, later ones must reuse its memory
+    churn();
+    size_t baseline = resident_bytes();
+    for (int round = 0; round < 5; round++)
+    {
+        churn();
+    }
+    size_t after = resident_bytes();
+#ifndef __SANITIZE_ADDRESS__
+    //a million nodes which leaked would take hundreds of megabytes
+    ASSERT_LT(after, baseline + 16 * 1024 * 1024);
+#endif
+}
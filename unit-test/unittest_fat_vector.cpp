@@ -28,3 +28,21 @@ TEST(test_fat_vector, test_conversion)
         cout << i << endl;
     }
 }
+
+TEST(test_fat_vector, test_batch)
+{
+    persistent::fat_vector<int> v;
+    v.resize(4);
+    auto ver0 = v.get_version();
+    {
+        auto batch = v.batch();
+        for (int i = 0; i < 100; i++)
+        {
+            v.update(1, i);
+        }
+        v.push_back(5);
+    }
+    ASSERT_EQ(v.get_version().get_id(), ver0.get_id() + 1);
+    ASSERT_EQ(v[1], 99);
+    ASSERT_EQ(v.size(), 5);
+}
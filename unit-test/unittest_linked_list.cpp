@@ -74,3 +74,161 @@ TEST(test_linked_list, test_erase)
         l.erase(l.begin());
     }
 }
+
+TEST(test_linked_list, test_collect_garbage)
+{
+    const int size = 20;
+    linked_list<int> l;
+    std::vector<version> old_versions;
+    for (int i = 0; i < size; i++)
+    {
+        l.push_front(i);
+        old_versions.push_back(l.get_version());
+    }
+    old_versions.pop_back();
+
+    for (auto& v : old_versions)
+    {
+        l.release_version(v);
+    }
+    l.collect_garbage();
+
+    ASSERT_EQ(l.size(), size);
+    int i = size - 1;
+    for (auto e : l)
+    {
+        ASSERT_EQ(e, i--);
+    }
+    l.push_front(size);
+    ASSERT_EQ(l.size(), size + 1);
+}
+
+TEST(test_linked_list, test_batch)
+{
+    const int size = 50;
+    linked_list<int> l;
+    auto v0 = l.get_version();
+    {
+        auto batch = l.batch();
+        for (int i = 0; i < size; i++)
+        {
+            l.push_front(i);
+        }
+        l.pop_front();
+    }
+    ASSERT_EQ(l.get_version().get_id(), v0.get_id() + 1);
+    ASSERT_EQ(l.size(), size - 1);
+    l.set_version(v0);
+    ASSERT_EQ(l.size(), 0);
+}
+
+TEST(test_linked_list, test_writes_with_splits)
+{
+    linked_list<int> l;
+    std::vector<int> expected;
+    std::vector<std::pair<version, std::vector<int>>> history;
+    srand(11);
+    for (int i = 0; i < 2000; i++)
+    {
+        int op = rand() % 4;
+        if (op == 0 && !expected.empty())
+        {
+            l.pop_front();
+            expected.erase(expected.begin());
+        }
+        else if (op == 1 && !expected.empty())
+        {
+            int value = expected[rand() % expected.size()];
+            l.erase(l.find(value));
+            expected.erase(std::find(expected.begin(), expected.end(), value));
+        }
+        else
+        {
+            l.push_front(i);
+            expected.insert(expected.begin(), i);
+        }
+        if (i % 40 == 0)
+        {
+            history.push_back(std::make_pair(l.get_version(), expected));
+        }
+    }
+
+    for (auto& h : history)
+    {
+        l.set_version(h.first);
+        ASSERT_EQ(l.size(), h.second.size());
+        ASSERT_TRUE(std::equal(h.second.begin(), h.second.end(), l.begin()));
+    }
+}
+
+//the length is kept in the head, whose copies relink the nodes after it
+TEST(test_linked_list, test_size_with_splits)
+{
+    linked_list<int, false, 2> l;
+    std::vector<int> expected;
+    srand(12);
+    for (int i = 0; i < 600; i++)
+    {
+        if (rand() % 3 == 0 && !expected.empty())
+        {
+            size_t index = rand() % std::min<size_t>(expected.size(), 3);
+            auto it = l.begin();
+            for (size_t j = 0; j < index; j++)
+            {
+                ++it;
+            }
+            it = l.erase(it);
+            expected.erase(expected.begin() + index);
+            //erase returns the live node after the erased one
+            for (; index < expected.size(); index++, ++it)
+            {
+                ASSERT_EQ(*it, expected[index]);
+            }
+            ASSERT_TRUE(it == l.end());
+        }
+        else
+        {
+            l.push_front(i);
+            expected.insert(expected.begin(), i);
+        }
+        ASSERT_EQ(l.size(), expected.size());
+        ASSERT_TRUE(std::equal(expected.begin(), expected.end(), l.begin()));
+    }
+}
+
+TEST(test_linked_list, test_fat_nodes)
+{
+    linked_list<int, true> l;
+    std::vector<std::pair<version, std::vector<int>>> history;
+    std::vector<int> expected;
+    for (int i = 0; i < 500; i++)
+    {
+        if (i % 3 == 2)
+        {
+            l.pop_front();
+            expected.erase(expected.begin());
+        }
+        else
+        {
+            l.push_front(i);
+            expected.insert(expected.begin(), i);
+        }
+        history.push_back(std::make_pair(l.get_version(), expected));
+    }
+
+    for (size_t i = 0; i + 1 < history.size(); i++)
+    {
+        if (i % 10)
+        {
+            l.release_version(history[i].first);
+        }
+    }
+    l.collect_garbage();
+
+    for (size_t i = 0; i < history.size(); i += 10)
+    {
+        l.set_version(history[i].first);
+        ASSERT_EQ(l.size(), history[i].second.size());
+        ASSERT_TRUE(std::equal(history[i].second.begin(), history[i].second.end(), l.begin()));
+    }
+}
@@ -0,0 +1,55 @@
+#include "gtest/gtest.h"
+#include <vector>
+#include "persistent.h"
+#include "map/map.cpp"
+
+TEST(test_map, test_subscript)
+{
+    persistent::map<int, int> m;
+    auto v0 = m.get_version();
+    //a missing key reads as 0 and isn't inserted
+    ASSERT_EQ((int)m[1], 0);
+    ASSERT_EQ(m.size(), 0);
+
+    m[1] = 5;
+    auto v1 = m.get_version();
+    m[1] = 6;
+    m[2] = m[1];
+    ASSERT_EQ((int)m[1], 6);
+    ASSERT_EQ((int)m[2], 6);
+    ASSERT_EQ(m.size(), 2);
+
+    //every write made a version, the older ones keep their values
+    m.set_version(v1);
+    ASSERT_EQ((int)m[1], 5);
+    ASSERT_EQ(m.size(), 1);
+    m.set_version(v0);
+    ASSERT_EQ(m.size(), 0);
+}
+
+TEST(test_map, test_bounds)
+{
+    persistent::map<int, int> m;
+    for (int i = 0; i < 100; i += 2)
+    {
+        m[i] = -i;
+    }
+    ASSERT_EQ(m.lower_bound(10)->key, 10);
+    ASSERT_EQ(m.lower_bound(11)->key, 12);
+    ASSERT_EQ(m.upper_bound(10)->key, 12);
+    ASSERT_TRUE(m.lower_bound(99) == m.end());
+    auto eq = m.equal_range(20);
+    ASSERT_EQ(eq.first->value, -20);
+    ASSERT_EQ(eq.second->key, 22);
+    eq = m.equal_range(21);
+    ASSERT_TRUE(eq.first == eq.second);
+
+    std::vector<int> keys;
+    for (auto& e : m.range(15, 25))
+    {
+        keys.push_back(e.key);
+    }
+    ASSERT_EQ(keys, std::vector<int>({ 16, 18, 20, 22, 24 }));
+    ASSERT_TRUE(m.range(31, 32).empty());
+    ASSERT_EQ(m.find(50)->value, -50);
+}
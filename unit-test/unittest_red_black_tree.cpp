@@ -0,0 +1,188 @@
+#include "gtest/gtest.h"
+#include <map>
+#include <set>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "persistent.h"
+
+//the root is black, no red node has a red child and every way down has as
+//many black nodes. the height bound alone misses a broken erase fix-up
+template <class tree_t>
+static void check_colors(tree_t& tree)
+{
+    ASSERT_GT(tree.black_height(), 0);
+}
+
+template <class tree_t>
+static void check_contents(tree_t& tree, const std::map<int, int>& expected)
+{
+    ASSERT_EQ(tree.size(), expected.size());
+    //a red-black tree of n keys is at most 2 log2(n + 1) high
+    ASSERT_LE(tree.height(), 2 * std::log2(expected.size() + 1));
+    check_colors(tree);
+    auto e = expected.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++e)
+    {
+        ASSERT_EQ(it->key, e->first);
+        ASSERT_EQ(it->value, e->second);
+    }
+}
+
+TEST(test_red_black_tree, test_insert_orders)
+{
+    const int n = 4096;
+    std::vector<int> sorted(n);
+    for (int i = 0; i < n; i++)
+    {
+        sorted[i] = i;
+    }
+    std::vector<int> reversed(sorted.rbegin(), sorted.rend());
+    std::vector<int> shuffled(sorted);
+    srand(1);
+    for (int i = 1; i < n; i++)
+    {
+        std::swap(shuffled[i], shuffled[rand() % (i + 1)]);
+    }
+
+    for (auto& order : { sorted, reversed, shuffled })
+    {
+        persistent::red_black_tree<int, int> tree;
+        std::map<int, int> expected;
+        for (int key : order)
+        {
+            tree.insert(key, -key);
+            expected[key] = -key;
+        }
+        check_contents(tree, expected);
+        ASSERT_EQ(tree.find(n / 2)->value, -n / 2);
+        ASSERT_TRUE(tree.find(n) == tree.end());
+    }
+}
+
+TEST(test_red_black_tree, test_erase)
+{
+    persistent::red_black_tree<int, int> tree;
+    std::map<int, int> expected;
+    for (int i = 0; i < 1000; i++)
+    {
+        tree.insert(i, i);
+        expected[i] = i;
+    }
+    //erase returns the next key
+    auto it = tree.erase(tree.find(500));
+    expected.erase(500);
+    ASSERT_EQ(it->key, 501);
+    for (int i = 0; i < 1000; i += 3)
+    {
+        tree.erase(tree.find(i));
+        expected.erase(i);
+        check_colors(tree);
+    }
+    check_contents(tree, expected);
+    ASSERT_TRUE(tree.erase(tree.find(999)) == tree.end());
+    expected.erase(999);
+    while (tree.begin() != tree.end())
+    {
+        tree.erase(tree.begin());
+        check_colors(tree);
+    }
+    ASSERT_EQ(tree.size(), 0);
+}
+
+//random edits with branches from older versions, every version keeps its
+//contents and its balance after the rotations of the later ones
+template <bool fat_node, size_t mod_box_size>
+static void check_versions()
+{
+    persistent::red_black_tree<int, int, fat_node, mod_box_size> tree;
+    std::map<int, int> expected;
+    std::vector<std::pair<persistent::version, std::map<int, int>>> history;
+    srand(5);
+    for (int i = 0; i < 3000; i++)
+    {
+        int key = rand() % 200;
+        if (rand() % 3 == 0)
+        {
+            tree.erase(tree.find(key));
+            expected.erase(key);
+        }
+        else
+        {
+            tree.insert(key, i);
+            expected[key] = i;
+        }
+        history.push_back(std::make_pair(tree.get_version(), expected));
+        if (i % 500 == 499)
+        {
+            auto& h = history[rand() % history.size()];
+            tree.set_version(h.first);
+            expected = h.second;
+        }
+    }
+
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        tree.set_version(history[i].first);
+        check_colors(tree);
+        if (i % 7 == 0)
+        {
+            check_contents(tree, history[i].second);
+        }
+    }
+
+    //released versions move their entries into the kept ones. an edit which
+    //changes nothing makes no version, and the newest one can't be released
+    persistent::version_id newest = 0;
+    for (auto& h : history)
+    {
+        newest = std::max(newest, h.first.get_id());
+    }
+    std::vector<std::pair<persistent::version, std::map<int, int>>> kept;
+    std::set<persistent::version_id> kept_ids;
+    for (size_t i = 0; i < history.size(); i++)
+    {
+        auto& v = history[i].first;
+        if (i % 50 == 0 || i + 1 == history.size() || v.get_id() == newest)
+        {
+            kept.push_back(history[i]);
+            kept_ids.insert(v.get_id());
+        }
+    }
+    tree.set_version(kept.back().first);
+    std::set<persistent::version_id> released;
+    for (auto& h : history)
+    {
+        if (!kept_ids.count(h.first.get_id()) && released.insert(h.first.get_id()).second)
+        {
+            tree.release_version(h.first);
+        }
+    }
+    tree.collect_garbage();
+    for (auto& h : kept)
+    {
+        tree.set_version(h.first);
+        check_contents(tree, h.second);
+    }
+}
+
+TEST(test_red_black_tree, test_versions)
+{
+    check_versions<false, 2>();
+    check_versions<false, persistent::default_mod_box_size>();
+    check_versions<true, persistent::default_mod_box_size>();
+}
+
+TEST(test_red_black_tree, test_nested)
+{
+    persistent::red_black_tree<int, persistent::red_black_tree<int, int>> tree;
+    for (int i = 0; i < 100; i++)
+    {
+        tree[i % 10].insert(i, i);
+    }
+    ASSERT_EQ(tree.size(), 10);
+    for (int i = 0; i < 10; i++)
+    {
+        ASSERT_EQ(tree.find(i)->value.size(), 10);
+    }
+}
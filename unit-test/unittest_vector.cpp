@@ -86,3 +86,37 @@ TEST(test_vector, test_undo_redo)
 
     ASSERT_EQ(v1.size(), 12);
 }
+
+TEST(test_vector, test_no_op_writes)
+{
+    persistent::vector<int> v;
+    v.resize(3, 7);
+    persistent::version ver0 = v.get_version();
+    v.update(1, 7);
+    v.resize(3);
+    ASSERT_TRUE(v.get_version() == ver0);
+
+    v.update(1, 8);
+    ASSERT_TRUE(v.get_version() != ver0);
+    ASSERT_EQ(v.get_version().get_id(), ver0.get_id() + 1);
+    ASSERT_TRUE(v[1] == 8);
+}
+
+TEST(test_vector, test_batch)
+{
+    persistent::vector<int> v;
+    persistent::version ver0 = v.get_version();
+    {
+        auto batch = v.batch();
+        for (int i = 0; i < 10; i++)
+        {
+            v.push_back(i);
+        }
+        v.update(0, -1);
+    }
+    ASSERT_EQ(v.get_version().get_id(), ver0.get_id() + 1);
+    ASSERT_EQ(v.size(), 10);
+    ASSERT_TRUE(v[0] == -1);
+    v.set_version(ver0);
+    ASSERT_EQ(v.size(), 0);
+}
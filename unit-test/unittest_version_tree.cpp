@@ -9,3 +9,246 @@ TEST(test_version_tree, test_insertion)
     auto v2 = vtree.insert(root_version, 2);
     ASSERT_LE(root_version, v2);
 }
+
+
+static bool is_ancestor(const std::vector<int>& parents, int a, int b)
+{
+    while (b != -1)
+    {
+        b = parents[b];
+        if (b == a)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(test_version_tree, test_ancestry)
+{
+    const int n = 2000;
+    persistent::version_tree<int> vtree;
+    std::vector<persistent::version> versions = { vtree.root_version() };
+    std::vector<int> parents = { -1 };
+    for (int i = 1; i < n; i++)
+    {
+        //mix of deep chains and hot-spot branching from a few versions
+        int parent = (i % 3 == 0) ? i - 1 : rand() % std::min(i, 8);
+        versions.push_back(vtree.insert(versions[parent], i));
+        parents.push_back(parent);
+    }
+
+    for (int k = 0; k < 20000; k++)
+    {
+        int a = rand() % n;
+        int b = rand() % n;
+        ASSERT_EQ(versions[a] < versions[b], is_ancestor(parents, a, b));
+        ASSERT_EQ(versions[a] == versions[b], a == b);
+    }
+}
+
+TEST(test_version_tree, test_local_relabeling)
+{
+    const int n = 100000;
+    persistent::version_tree<int> vtree;
+    auto root = vtree.root_version();
+    auto last = root;
+    for (int i = 0; i < n; i++)
+    {
+        vtree.insert(root, i);
+        last = vtree.insert(last, i);
+    }
+    ASSERT_EQ(vtree.size(), 2 * n + 1);
+    ASSERT_TRUE(root < last);
+
+    //relabeling stays local, a global redistribution per insertion would
+    //make this quadratic
+    auto stats = vtree.get_order_stats();
+    ASSERT_LT(stats.relabel_count, (size_t)(2 * n) * 64);
+}
+
+TEST(test_version_tree, test_wide_labels)
+{
+    //group labels alone address far more than 2^32 versions
+    ASSERT_GE((int)persistent::label_traits<persistent::label_type>::bits, 64);
+    ASSERT_GE((int)persistent::order_list_t::group_bits, 40);
+
+    //order list node ids of the largest version id don't wrap, new_version_internal throws past it
+    ASSERT_EQ(persistent::end_node(persistent::max_version_id), UINT32_MAX);
+    ASSERT_LT(persistent::end_node(persistent::max_version_id - 1), persistent::begin_node(persistent::max_version_id));
+
+    //a deep linear history exhausted the 32-bit label space after a few dozens
+    //of versions and then redistributed globally on every other insertion
+    const int n = 1 << 20;
+    persistent::version_tree<int> vtree;
+    std::vector<persistent::version> versions = { vtree.root_version() };
+    for (int i = 1; i <= n; i++)
+    {
+        versions.push_back(vtree.insert(versions.back(), i));
+    }
+
+    const persistent::label_type max_32 = std::numeric_limits<unsigned>::max();
+    ASSERT_GT(versions[n / 2].get_begin_label(), max_32);
+    for (int k = 0; k < 10000; k++)
+    {
+        int a = rand() % (n + 1);
+        int b = rand() % (n + 1);
+        ASSERT_EQ(versions[a] < versions[b], a < b);
+    }
+    auto stats = vtree.get_order_stats();
+    ASSERT_LT(stats.relabel_count, (size_t)n * 64);
+}
+
+TEST(test_version_tree, test_slab)
+{
+    persistent::slab<int, 4> s;
+    std::vector<int*> addresses;
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(s.push_back(i), (uint32_t)i);
+        addresses.push_back(&s[i]);
+    }
+    ASSERT_EQ(s.size(), 1000);
+    for (int i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(&s[i], addresses[i]);
+        ASSERT_EQ(s[i], i);
+    }
+}
+
+TEST(test_version_tree, test_release)
+{
+    persistent::version_tree<int> vtree;
+    auto root = vtree.root_version();
+    auto a = vtree.insert(root, 1);
+    auto b = vtree.insert(a, 2);
+    auto c = vtree.insert(a, 3);
+    auto d = vtree.insert(c, 4);
+    ASSERT_EQ(vtree.size(), 5);
+
+    vtree.release(b);
+    vtree.release(a);
+    vtree.release(c);
+    ASSERT_TRUE(vtree.is_released(a));
+    ASSERT_EQ(vtree.size(), 2);
+
+    vtree.begin_collection();
+    ASSERT_TRUE(vtree.get_heirs(b).empty());
+    ASSERT_EQ(vtree.get_heirs(a).size(), 1);
+    ASSERT_TRUE(vtree.get_heirs(a)[0] == d);
+    ASSERT_TRUE(vtree.get_heirs(c)[0] == d);
+    //labels of released versions are valid during the collection
+    ASSERT_TRUE(a < c);
+
+    int removed = 0;
+    vtree.end_collection([&](int)
+    {
+        removed++;
+    });
+    ASSERT_EQ(removed, 3);
+    ASSERT_FALSE(a < d);
+    ASSERT_TRUE(root < d);
+    ASSERT_EQ(vtree.get_value(d), 4);
+
+    auto e = vtree.insert(root, 5);
+    ASSERT_LT(e.get_id(), 4);
+    ASSERT_TRUE(root < e);
+    ASSERT_FALSE(d < e);
+    ASSERT_EQ(vtree.size(), 3);
+}
+
+TEST(test_version_tree, test_retention_policy)
+{
+    auto last = persistent::retention_policy::keep_last(3).select(10);
+    ASSERT_EQ(std::count(last.begin(), last.end(), true), 3);
+    ASSERT_TRUE(last[7] && last[8] && last[9]);
+
+    //4 recent versions plus one per age range of 1, 2, 4, ... versions
+    auto geometric = persistent::retention_policy::geometric(4).select(4 + 63);
+    ASSERT_EQ(std::count(geometric.begin(), geometric.end(), true), 4 + 6);
+    ASSERT_TRUE(geometric[0]);
+    ASSERT_TRUE(geometric[62]);
+    ASSERT_FALSE(geometric[61]);
+
+    auto all = persistent::retention_policy::keep_all().select(10);
+    ASSERT_EQ(std::count(all.begin(), all.end(), true), 10);
+    ASSERT_FALSE(persistent::retention_policy::keep_all().is_over_budget(1 << 30));
+    ASSERT_TRUE(persistent::retention_policy::keep_all().with_memory_budget(100).is_over_budget(101));
+}
+
+TEST(test_version_tree, test_partial_persistence)
+{
+    persistent::version_tree<int> vtree(0, persistent::persistence_mode::partial);
+    std::vector<persistent::version> versions = { vtree.root_version() };
+    for (int i = 1; i < 100; i++)
+    {
+        versions.push_back(vtree.insert(versions.back(), i));
+    }
+    for (int i = 0; i < 100; i++)
+    {
+        ASSERT_EQ(vtree.get_value(versions[i]), i);
+        for (int j = 0; j < 100; j++)
+        {
+            ASSERT_EQ(versions[i] < versions[j], i < j);
+        }
+    }
+    ASSERT_EQ(vtree.get_order_stats().relabel_count, 0);
+
+    vtree.release(versions[50]);
+    vtree.begin_collection();
+    ASSERT_TRUE(vtree.get_heirs(versions[50])[0] == versions[51]);
+    vtree.end_collection([](int)
+    {
+    });
+    ASSERT_TRUE(versions[49] < versions[51]);
+    ASSERT_FALSE(versions[49] < versions[50]);
+
+    ASSERT_THROW(vtree.insert(versions[10], -1), std::logic_error);
+}
+
+TEST(test_version_tree, test_mod_index)
+{
+    persistent::version_tree<int> vtree;
+    std::vector<persistent::version> versions = { vtree.root_version() };
+    srand(3);
+    for (int i = 1; i < 200; i++)
+    {
+        versions.push_back(vtree.insert(versions[rand() % versions.size()], i));
+    }
+
+    persistent::mod_index<2> index;
+    std::vector<std::pair<size_t, persistent::version>> box;
+    while (box.size() < 16)
+    {
+        //a field has one entry per version
+        auto mod_entry = std::make_pair(box.size() % 2, versions[rand() % versions.size()]);
+        if (index.find_exact(mod_entry.first, mod_entry.second) == -1)
+        {
+            index.insert(mod_entry.first, mod_entry.second, box.size());
+            box.push_back(mod_entry);
+        }
+    }
+    //relabeling keeps the index sorted
+    for (int i = 0; i < 1000; i++)
+    {
+        versions.push_back(vtree.insert(versions[rand() % 200], i));
+    }
+
+    for (auto& v : versions)
+    {
+        for (size_t field = 0; field < 2; field++)
+        {
+            int expected = -1;
+            for (size_t slot = 0; slot < box.size(); slot++)
+            {
+                if (box[slot].first == field && box[slot].second <= v &&
+                    (expected < 0 || box[expected].second < box[slot].second))
+                {
+                    expected = (int)slot;
+                }
+            }
+            ASSERT_EQ(index.find(field, v), expected);
+        }
+    }
+    ASSERT_EQ(index.find_exact(box[3].first, box[3].second) % 2, 1);
+}